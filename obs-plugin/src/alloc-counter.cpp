@@ -0,0 +1,71 @@
+#include "alloc-counter.h"
+
+#ifdef SR_ALLOC_TRACKING
+
+#include <cstdlib>
+#include <new>
+
+static thread_local uint64_t thread_allocs = 0;
+static thread_local int thread_paused = 0;
+
+/*
+ * The array and nothrow forms forward to these, so replacing them catches
+ * every non-aligned allocation.
+ */
+void *operator new(std::size_t size)
+{
+	if (!thread_paused)
+		thread_allocs++;
+	void *p = std::malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+bool sr_alloc_tracking_enabled()
+{
+	return true;
+}
+
+uint64_t sr_alloc_count()
+{
+	return thread_allocs;
+}
+
+SrAllocPause::SrAllocPause()
+{
+	thread_paused++;
+}
+
+SrAllocPause::~SrAllocPause()
+{
+	thread_paused--;
+}
+
+#else
+
+bool sr_alloc_tracking_enabled()
+{
+	return false;
+}
+
+uint64_t sr_alloc_count()
+{
+	return 0;
+}
+
+SrAllocPause::SrAllocPause() {}
+
+SrAllocPause::~SrAllocPause() {}
+
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * Debug accounting of C++ heap allocations. Built with SR_ALLOC_TRACKING
+ * (cmake -DENABLE_ALLOC_TRACKING=ON, sr-ocr-bench only), the global
+ * operator new counts every allocation made by the calling thread;
+ * otherwise the count stays at 0. The plugin module is never built with
+ * it: a replacement operator new in a library loaded with dlopen does not
+ * reliably take over from the one the host process already bound to.
+ * Allocations inside C libraries (libobs, curl) go through malloc and are
+ * not counted. Tesseract's C++ internals would be, so calls into it run
+ * under SrAllocPause.
+ */
+
+bool sr_alloc_tracking_enabled();
+
+/** Allocations made by the calling thread so far */
+uint64_t sr_alloc_count();
+
+/**
+ * Stops counting the calling thread's allocations while in scope, for
+ * calls into libraries whose internals the check can't act on. Nests.
+ */
+class SrAllocPause {
+public:
+	SrAllocPause();
+	~SrAllocPause();
+
+	SrAllocPause(const SrAllocPause &) = delete;
+	SrAllocPause &operator=(const SrAllocPause &) = delete;
+};
@@ -1,10 +1,26 @@
 #include "api-client.h"
 #include "plugin-support.h"
+#include "trace.h"
 
 #include <curl/curl.h>
+#include <zlib.h>
+#include <algorithm>
+#include <chrono>
 #include <ctime>
+#include <cstdio>
 #include <string>
-#include <sstream>
+
+// Upper bound on events held while the API is unreachable
+#define MAX_PENDING_EVENTS 10000
+
+#define CONTENT_TYPE_JSON "application/json"
+#define CONTENT_TYPE_BINARY "application/x-sr-batch; v=1"
+
+// Body of a single-mode post
+#define SINGLE_EVENT_JSON "{\"sr\":%d,\"timestamp\":%lld}"
+
+// Longest the transport thread sleeps before rechecking for aborts
+#define TRANSPORT_POLL_MS 1000
 
 // Discard response body
 static size_t write_discard(void *, size_t size, size_t nmemb, void *)
@@ -12,101 +28,780 @@ static size_t write_discard(void *, size_t size, size_t nmemb, void *)
 	return size * nmemb;
 }
 
-ApiClient::ApiClient() : curl_initialized(false)
+/* ------------------------------------------------------------------ */
+/* Batch encoders                                                      */
+/* ------------------------------------------------------------------ */
+
+static uint64_t zigzag(int64_t v)
+{
+	return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static void put_varint(std::string &out, uint64_t v)
+{
+	while (v >= 0x80) {
+		out += (char)((v & 0x7F) | 0x80);
+		v >>= 7;
+	}
+	out += (char)v;
+}
+
+/*
+ * Binary layout: "SRB1", varint count, then per event a zigzag varint
+ * timestamp delta (seconds) and a zigzag varint SR delta. The first event's
+ * deltas are relative to zero. A typical event costs 2-3 bytes.
+ */
+static void encode_binary(const std::vector<SrEvent> &events,
+			  std::string &out)
+{
+	out = "SRB1";
+	put_varint(out, events.size());
+
+	int64_t prev_ts = 0;
+	int64_t prev_sr = 0;
+	for (const SrEvent &ev : events) {
+		put_varint(out, zigzag(ev.timestamp - prev_ts));
+		put_varint(out, zigzag((int64_t)ev.sr - prev_sr));
+		prev_ts = ev.timestamp;
+		prev_sr = ev.sr;
+	}
+}
+
+static void encode_json_array(const std::vector<SrEvent> &events,
+			      std::string &out)
+{
+	char item[64];
+	out.clear();
+	out.reserve(events.size() * 40 + 2);
+	out += '[';
+	for (size_t i = 0; i < events.size(); i++) {
+		int n = snprintf(item, sizeof(item),
+				 "%s{\"sr\":%d,\"timestamp\":%lld}",
+				 i > 0 ? "," : "", events[i].sr,
+				 (long long)events[i].timestamp);
+		out.append(item, (size_t)n);
+	}
+	out += ']';
+}
+
+static bool gzip_compress(const std::string &in, std::string &out)
+{
+	z_stream zs = {};
+	// 15 + 16: max window with a gzip header instead of raw zlib
+	if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+			 Z_DEFAULT_STRATEGY) != Z_OK)
+		return false;
+
+	out.resize(deflateBound(&zs, (uLong)in.size()));
+	zs.next_in = (Bytef *)in.data();
+	zs.avail_in = (uInt)in.size();
+	zs.next_out = (Bytef *)&out[0];
+	zs.avail_out = (uInt)out.size();
+
+	int res = deflate(&zs, Z_FINISH);
+	out.resize(zs.total_out);
+	deflateEnd(&zs);
+	return res == Z_STREAM_END;
+}
+
+static const char *mode_name(UploadMode mode)
+{
+	switch (mode) {
+	case UploadMode::BinaryBatch:
+		return "binary";
+	case UploadMode::GzipJson:
+		return "gzip json";
+	default:
+		return "json";
+	}
+}
+
+/* ------------------------------------------------------------------ */
+/* ApiClient                                                           */
+/* ------------------------------------------------------------------ */
+
+ApiClient::ApiClient()
+	: curl_initialized(false),
+	  upload_mode(UploadMode::Single),
+	  negotiated_mode(UploadMode::Single),
+	  batch_max_events(50),
+	  batch_max_age(30),
+	  batch_started(0),
+	  stats(),
+	  record_latencies(false),
+	  multi(nullptr),
+	  stopping(false),
+	  abort_at(std::chrono::steady_clock::time_point::max())
 {
 	if (curl_global_init(CURL_GLOBAL_DEFAULT) == CURLE_OK)
 		curl_initialized = true;
 	else
 		sr_log_error("curl_global_init failed");
+
+	if (curl_initialized && !(multi = curl_multi_init()))
+		sr_log_error("curl_multi_init failed");
+	if (multi)
+		transport_thread =
+			std::thread(&ApiClient::transport_loop, this);
 }
 
 ApiClient::~ApiClient()
 {
+	// Abort whatever is still in flight (async sends) and stop
+	{
+		std::lock_guard<std::mutex> lock(transport_mutex);
+		stopping = true;
+		abort_at = std::chrono::steady_clock::now();
+	}
+	if (multi)
+		curl_multi_wakeup(multi);
+	if (transport_thread.joinable())
+		transport_thread.join();
+	if (multi)
+		curl_multi_cleanup(multi);
+
+	for (CURL *curl : idle_handles)
+		curl_easy_cleanup(curl);
+	endpoint.reset();
+
 	if (curl_initialized)
 		curl_global_cleanup();
 }
 
+ApiClient::Endpoint::Endpoint()
+	: json_headers(nullptr), gzip_headers(nullptr), binary_headers(nullptr)
+{
+}
+
+ApiClient::Endpoint::~Endpoint()
+{
+	curl_slist_free_all(json_headers);
+	curl_slist_free_all(gzip_headers);
+	curl_slist_free_all(binary_headers);
+}
+
+static curl_slist *build_headers(const std::string &auth_header,
+				 const char *content_type,
+				 const char *content_encoding)
+{
+	std::string type_header = std::string("Content-Type: ") + content_type;
+
+	curl_slist *headers = nullptr;
+	headers = curl_slist_append(headers, type_header.c_str());
+	headers = curl_slist_append(headers, auth_header.c_str());
+	if (content_encoding) {
+		std::string enc_header =
+			std::string("Content-Encoding: ") + content_encoding;
+		headers = curl_slist_append(headers, enc_header.c_str());
+	}
+	return headers;
+}
+
 void ApiClient::configure(const std::string &url, const std::string &api_key)
 {
-	std::lock_guard<std::mutex> lock(config_mutex);
-	endpoint_url = url;
-	auth_key = api_key;
+	std::shared_ptr<Endpoint> next;
+	if (!url.empty() && !api_key.empty()) {
+		std::string auth_header = "Authorization: Bearer " + api_key;
+		next = std::make_shared<Endpoint>();
+		next->url = url;
+		next->json_headers =
+			build_headers(auth_header, CONTENT_TYPE_JSON, nullptr);
+		next->gzip_headers =
+			build_headers(auth_header, CONTENT_TYPE_JSON, "gzip");
+		next->binary_headers = build_headers(
+			auth_header, CONTENT_TYPE_BINARY, nullptr);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(config_mutex);
+		endpoint = std::move(next);
+	}
 
 	if (!url.empty())
 		sr_log_info("API client configured: %s", url.c_str());
 }
 
+std::shared_ptr<const ApiClient::Endpoint> ApiClient::get_endpoint() const
+{
+	std::lock_guard<std::mutex> lock(config_mutex);
+	return endpoint;
+}
+
+void ApiClient::configure_batching(UploadMode mode, size_t max_events,
+				   int max_age_seconds)
+{
+	std::lock_guard<std::mutex> lock(batch_mutex);
+
+	// A mode change restarts negotiation from the requested format
+	if (mode != upload_mode)
+		negotiated_mode = mode;
+	upload_mode = mode;
+	batch_max_events = max_events > 0 ? max_events : 1;
+	batch_max_age = max_age_seconds > 0 ? max_age_seconds : 1;
+}
+
 bool ApiClient::is_configured() const
 {
 	std::lock_guard<std::mutex> lock(config_mutex);
-	return !endpoint_url.empty() && !auth_key.empty();
+	return endpoint != nullptr;
 }
 
-bool ApiClient::send_sr(int sr_value)
+UploadStats ApiClient::get_stats() const
 {
-	std::string url;
-	std::string key;
+	std::lock_guard<std::mutex> lock(batch_mutex);
+	return stats;
+}
 
+void ApiClient::set_latency_recording(bool enabled)
+{
+	std::lock_guard<std::mutex> lock(batch_mutex);
+	record_latencies = enabled;
+	if (!enabled)
+		latencies.clear();
+}
+
+std::vector<double> ApiClient::take_latencies()
+{
+	std::lock_guard<std::mutex> lock(batch_mutex);
+	std::vector<double> out;
+	out.swap(latencies);
+	return out;
+}
+
+void ApiClient::begin_shutdown(int grace_ms)
+{
+	auto deadline = std::chrono::steady_clock::now() +
+			std::chrono::milliseconds(grace_ms);
 	{
-		std::lock_guard<std::mutex> lock(config_mutex);
-		url = endpoint_url;
-		key = auth_key;
+		std::lock_guard<std::mutex> lock(transport_mutex);
+		abort_at = std::min(abort_at, deadline);
 	}
+	if (multi)
+		curl_multi_wakeup(multi);
 
-	if (url.empty() || key.empty())
-		return false;
+	// The deadline now bounds every request, so this can't outlast it
+	drain_batch();
+}
 
-	if (!curl_initialized)
-		return false;
+/* ------------------------------------------------------------------ */
+/* Transport                                                           */
+/* ------------------------------------------------------------------ */
 
-	CURL *curl = curl_easy_init();
-	if (!curl) {
+bool ApiClient::prepare(Transfer &t, std::shared_ptr<const Endpoint> target,
+			curl_slist *headers, const char *body, size_t size)
+{
+	CURL *curl = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(transport_mutex);
+		if (!idle_handles.empty()) {
+			curl = idle_handles.back();
+			idle_handles.pop_back();
+		}
+	}
+	if (curl) {
+		// Drops the previous request's options, keeps its connection
+		curl_easy_reset(curl);
+	} else if (!(curl = curl_easy_init())) {
 		sr_log_warn("curl_easy_init failed");
 		return false;
 	}
 
-	// Build JSON payload
-	std::time_t now = std::time(nullptr);
-	std::ostringstream json;
-	json << "{\"sr\":" << sr_value << ",\"timestamp\":" << now << "}";
-	std::string body = json.str();
-
-	// Build auth header
-	std::string auth_header = "Authorization: Bearer " + key;
-
-	struct curl_slist *headers = nullptr;
-	headers = curl_slist_append(headers, "Content-Type: application/json");
-	headers = curl_slist_append(headers, auth_header.c_str());
-
-	curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+	curl_easy_setopt(curl, CURLOPT_URL, target->url.c_str());
 	curl_easy_setopt(curl, CURLOPT_POST, 1L);
-	curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
+	curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body);
+	curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)size);
 	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
 	curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
 	curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 5L);
+	curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
 	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_discard);
 	curl_easy_setopt(curl, CURLOPT_USERAGENT, "obs-sr-tracker/1.0");
+	curl_easy_setopt(curl, CURLOPT_PRIVATE, &t);
 
-	CURLcode res = curl_easy_perform(curl);
+	t.curl = curl;
+	t.endpoint = std::move(target);
+	t.done = false;
+	t.result = CURLE_OK;
+	t.http_code = 0;
+	return true;
+}
+
+/* Hand a prepared request to the transport thread */
+bool ApiClient::submit(Transfer *t)
+{
+	{
+		std::lock_guard<std::mutex> lock(transport_mutex);
+		if (stopping ||
+		    std::chrono::steady_clock::now() >= abort_at) {
+			idle_handles.push_back(t->curl);
+			return false;
+		}
+		t->started = std::chrono::steady_clock::now();
+		queued.push_back(t);
+	}
+	curl_multi_wakeup(multi);
+	return true;
+}
+
+bool ApiClient::post(const std::shared_ptr<const Endpoint> &target,
+		     curl_slist *headers, const char *body, size_t size,
+		     long *http_code)
+{
+	*http_code = 0;
+
+	if (!multi)
+		return false;
+
+	Transfer t = {};
+	if (!prepare(t, target, headers, body, size))
+		return false;
+
+	SR_TRACE_SCOPE("http_post");
+	if (!submit(&t)) {
+		sr_log_warn("API request not sent: shutting down");
+		return false;
+	}
+
+	std::unique_lock<std::mutex> lock(transport_mutex);
+	transport_cv.wait(lock, [&t] { return t.done; });
+	*http_code = t.http_code;
+	return t.result == CURLE_OK;
+}
+
+/* Transport thread: finish a request and hand the result back */
+void ApiClient::complete(Transfer *t, int result)
+{
+	auto it = std::find(active.begin(), active.end(), t);
+	if (it != active.end()) {
+		curl_multi_remove_handle(multi, t->curl);
+		active.erase(it);
+	}
+
+	long http_code = 0;
+	if (result == CURLE_OK)
+		curl_easy_getinfo(t->curl, CURLINFO_RESPONSE_CODE, &http_code);
+	else if (result == CURLE_ABORTED_BY_CALLBACK)
+		sr_log_warn("API request aborted: shutting down");
+	else
+		sr_log_warn("API request failed: %s",
+			    curl_easy_strerror((CURLcode)result));
+
+	std::chrono::duration<double, std::milli> elapsed =
+		std::chrono::steady_clock::now() - t->started;
+	int64_t ms = (int64_t)elapsed.count();
+	{
+		std::lock_guard<std::mutex> lock(batch_mutex);
+		if (record_latencies)
+			latencies.push_back(elapsed.count());
+		int bucket = 0;
+		while (bucket < UPLOAD_LATENCY_BUCKETS - 1 &&
+		       ms >= (int64_t)1 << bucket)
+			bucket++;
+		stats.latency_buckets[bucket]++;
+		if (result != CURLE_OK)
+			stats.failed_requests++;
+	}
+
+	if (t->async) {
+		if (result == CURLE_OK)
+			record_single(t->sr_value, t->body.size(), http_code);
+		{
+			std::lock_guard<std::mutex> lock(transport_mutex);
+			idle_handles.push_back(t->curl);
+		}
+		delete t;
+		return;
+	}
+
+	// The waiting caller owns t and may free it once done is set
+	{
+		std::lock_guard<std::mutex> lock(transport_mutex);
+		idle_handles.push_back(t->curl);
+		t->result = result;
+		t->http_code = http_code;
+		t->done = true;
+	}
+	transport_cv.notify_all();
+}
+
+void ApiClient::transport_loop()
+{
+	sr_trace_set_thread_name("api_transport");
+
+	std::vector<Transfer *> incoming;
+	for (;;) {
+		bool abort_all;
+		{
+			std::lock_guard<std::mutex> lock(transport_mutex);
+			incoming.swap(queued);
+			abort_all = std::chrono::steady_clock::now() >=
+				    abort_at;
+			if (stopping && incoming.empty() && active.empty())
+				break;
+		}
+
+		for (Transfer *t : incoming) {
+			if (abort_all) {
+				complete(t, CURLE_ABORTED_BY_CALLBACK);
+				continue;
+			}
+			curl_multi_add_handle(multi, t->curl);
+			active.push_back(t);
+		}
+		incoming.clear();
+
+		while (abort_all && !active.empty())
+			complete(active.back(), CURLE_ABORTED_BY_CALLBACK);
+
+		int running = 0;
+		curl_multi_perform(multi, &running);
+
+		CURLMsg *msg;
+		int left = 0;
+		while ((msg = curl_multi_info_read(multi, &left))) {
+			if (msg->msg != CURLMSG_DONE)
+				continue;
+			// msg dies with the handle's removal: read it first
+			CURLcode result = msg->data.result;
+			Transfer *t = nullptr;
+			curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE,
+					  (char **)&t);
+			complete(t, result);
+		}
+
+		// Sleep until a socket is ready, a caller wakes us, or the
+		// abort deadline passes
+		int timeout_ms = TRANSPORT_POLL_MS;
+		{
+			std::lock_guard<std::mutex> lock(transport_mutex);
+			auto left_ms = std::chrono::duration_cast<
+					       std::chrono::milliseconds>(
+					       abort_at -
+					       std::chrono::steady_clock::now())
+					       .count();
+			if (abort_at !=
+			    std::chrono::steady_clock::time_point::max())
+				timeout_ms = (int)std::clamp<int64_t>(
+					left_ms + 1, 0, timeout_ms);
+			if (!queued.empty())
+				timeout_ms = 0;
+		}
+		curl_multi_poll(multi, nullptr, 0, timeout_ms, nullptr);
+	}
+}
+
+/* ------------------------------------------------------------------ */
+/* Sending                                                             */
+/* ------------------------------------------------------------------ */
+
+/* Account for a single-mode post and log how it went */
+bool ApiClient::record_single(int sr_value, size_t size, long http_code)
+{
+	{
+		std::lock_guard<std::mutex> lock(batch_mutex);
+		stats.events++;
+		stats.requests++;
+		stats.payload_bytes += size;
+		stats.unbatched_bytes += size;
+	}
+
+	if (http_code >= 200 && http_code < 300) {
+		sr_log_info("SR %d posted to API (HTTP %ld)", sr_value,
+			    http_code);
+		return true;
+	}
+
+	sr_log_warn("API returned HTTP %ld for SR %d", http_code, sr_value);
+	return false;
+}
+
+bool ApiClient::send_sr(int sr_value)
+{
+	std::time_t now = std::time(nullptr);
+
+	UploadMode mode;
+	{
+		std::lock_guard<std::mutex> lock(batch_mutex);
+		mode = upload_mode;
+	}
+
+	// Batched modes: queue and let the size/age bounds decide when the
+	// request actually goes out
+	if (mode != UploadMode::Single) {
+		queue_sr(sr_value, (int64_t)now);
+		return true;
+	}
+
+	std::shared_ptr<const Endpoint> target = get_endpoint();
+	if (!target)
+		return false;
+
+	// Build JSON payload
+	char body[64];
+	int size = snprintf(body, sizeof(body), SINGLE_EVENT_JSON, sr_value,
+			    (long long)now);
+
+	long http_code = 0;
+	if (!post(target, target->json_headers, body, (size_t)size,
+		  &http_code))
+		return false;
+
+	return record_single(sr_value, (size_t)size, http_code);
+}
+
+void ApiClient::send_sr_async(int sr_value)
+{
+	std::time_t now = std::time(nullptr);
+
+	{
+		std::lock_guard<std::mutex> lock(batch_mutex);
+		if (upload_mode != UploadMode::Single) {
+			// Flushing here would block the caller; leave it to
+			// the next poll_batch()
+			append_event(sr_value, (int64_t)now);
+			return;
+		}
+	}
+
+	std::shared_ptr<const Endpoint> target = get_endpoint();
+	if (!target || !multi)
+		return;
+
+	char body[64];
+	int size = snprintf(body, sizeof(body),
+			    "{\"sr\":%d,\"timestamp\":%lld}", sr_value,
+			    (long long)now);
+
+	// Owned by the transport thread once submitted
+	auto *t = new Transfer();
+	t->async = true;
+	t->sr_value = sr_value;
+	t->body.assign(body, (size_t)size);
+	if (!prepare(*t, target, target->json_headers, t->body.data(),
+		     t->body.size()) ||
+	    !submit(t)) {
+		sr_log_warn("API request for SR %d not sent", sr_value);
+		delete t;
+	}
+}
+
+/* Caller holds batch_mutex */
+void ApiClient::append_event(int sr_value, int64_t timestamp)
+{
+	if (batch.empty())
+		batch_started = (int64_t)std::time(nullptr);
+	batch.push_back({sr_value, timestamp});
+	trim_batch();
+}
+
+/* Drop the oldest events past the pending cap. Caller holds batch_mutex. */
+void ApiClient::trim_batch()
+{
+	if (batch.size() <= MAX_PENDING_EVENTS)
+		return;
+
+	size_t excess = batch.size() - MAX_PENDING_EVENTS;
+	stats.dropped_events += excess;
+	batch.erase(batch.begin(), batch.begin() + excess);
+	sr_log_warn("Upload backlog full, dropped %zu oldest SR events",
+		    excess);
+}
+
+size_t ApiClient::pending_events() const
+{
+	std::lock_guard<std::mutex> lock(batch_mutex);
+	return batch.size();
+}
+
+void ApiClient::queue_sr(int sr_value, int64_t timestamp)
+{
+	bool full;
+	{
+		std::lock_guard<std::mutex> lock(batch_mutex);
+		append_event(sr_value, timestamp);
+		full = batch.size() >= batch_max_events;
+	}
+
+	if (full)
+		flush_batch();
+}
+
+bool ApiClient::drain_batch()
+{
+	bool sent = true;
+	while (sent && pending_events() > 0)
+		sent = flush_batch();
+	return sent;
+}
+
+void ApiClient::poll_batch()
+{
+	bool due;
+	{
+		std::lock_guard<std::mutex> lock(batch_mutex);
+		due = !batch.empty() &&
+		      (batch.size() >= batch_max_events ||
+		       (int64_t)std::time(nullptr) - batch_started >=
+			       batch_max_age);
+	}
+
+	if (due)
+		flush_batch();
+}
+
+bool ApiClient::encode_batch(const std::vector<SrEvent> &events,
+			     UploadMode mode, std::string &body) const
+{
+	if (mode == UploadMode::BinaryBatch) {
+		encode_binary(events, body);
+		return true;
+	}
+
+	std::string json;
+	encode_json_array(events, json);
+
+	if (mode == UploadMode::GzipJson)
+		return gzip_compress(json, body);
+
+	body = std::move(json);
+	return true;
+}
+
+/*
+ * Single-mode fallback for queued events: one JSON object per request,
+ * oldest first, stopping at the first failure. Returns how many went out.
+ */
+size_t ApiClient::post_each(const std::shared_ptr<const Endpoint> &target,
+			    const std::vector<SrEvent> &events)
+{
+	char body[64];
+
+	for (size_t i = 0; i < events.size(); i++) {
+		const SrEvent &ev = events[i];
+		int size = snprintf(body, sizeof(body), SINGLE_EVENT_JSON,
+				    ev.sr, (long long)ev.timestamp);
 
-	bool success = false;
-	if (res == CURLE_OK) {
 		long http_code = 0;
-		curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+		if (!post(target, target->json_headers, body, (size_t)size,
+			  &http_code) ||
+		    !record_single(ev.sr, (size_t)size, http_code))
+			return i;
+	}
+	return events.size();
+}
+
+/* Account for a batch request that went out and log the savings */
+void ApiClient::record_batch(const std::vector<SrEvent> &events,
+			     UploadMode mode, size_t size)
+{
+	uint64_t unbatched = 0;
+	char single[64];
+	for (const SrEvent &ev : events)
+		unbatched += (uint64_t)snprintf(single, sizeof(single),
+						SINGLE_EVENT_JSON, ev.sr,
+						(long long)ev.timestamp);
+
+	std::lock_guard<std::mutex> lock(batch_mutex);
+	stats.events += events.size();
+	stats.requests++;
+	stats.payload_bytes += size;
+	stats.unbatched_bytes += unbatched;
+
+	sr_log_info(
+		"Batch of %zu SR events posted (%s, %zu bytes vs %llu bytes in %zu requests unbatched)",
+		events.size(), mode_name(mode), size,
+		(unsigned long long)unbatched, events.size());
+	sr_log_info("Upload totals: %llu events in %llu requests, %llu of %llu bytes",
+		    (unsigned long long)stats.events,
+		    (unsigned long long)stats.requests,
+		    (unsigned long long)stats.payload_bytes,
+		    (unsigned long long)stats.unbatched_bytes);
+}
+
+bool ApiClient::flush_batch()
+{
+	// One flush at a time keeps events ordered on the wire
+	std::lock_guard<std::mutex> flush_lock(flush_mutex);
+
+	std::shared_ptr<const Endpoint> target = get_endpoint();
+
+	// Oldest events first and never more than one batch per request, so
+	// a backlog built up while the API was down can't turn into one
+	// oversized post. The rest stays queued for the next flush.
+	std::vector<SrEvent> events;
+	UploadMode mode;
+	{
+		std::lock_guard<std::mutex> lock(batch_mutex);
+		size_t count = std::min(batch.size(), batch_max_events);
+		events.assign(batch.begin(), batch.begin() + count);
+		batch.erase(batch.begin(), batch.begin() + count);
+		mode = negotiated_mode;
+	}
+
+	if (events.empty())
+		return true;
+
+	size_t sent = 0;
+	std::string body;
+
+	while (target) {
+		// The single-object endpoint takes no arrays: post each event
+		if (mode == UploadMode::Single) {
+			sent = post_each(target, events);
+			break;
+		}
+
+		if (!encode_batch(events, mode, body)) {
+			sr_log_warn("Batch encoding failed (%s)",
+				    mode_name(mode));
+			mode = UploadMode::Single;
+			continue;
+		}
+
+		curl_slist *headers = target->json_headers;
+		if (mode == UploadMode::BinaryBatch)
+			headers = target->binary_headers;
+		else if (mode == UploadMode::GzipJson)
+			headers = target->gzip_headers;
+
+		long http_code = 0;
+		if (!post(target, headers, body.data(), body.size(),
+			  &http_code))
+			break;
+
+		// Server doesn't understand this format — step down
+		// binary -> gzip json -> single posts and retry
+		if (http_code == 415) {
+			UploadMode next = UploadMode::Single;
+			if (mode == UploadMode::BinaryBatch)
+				next = UploadMode::GzipJson;
+			sr_log_warn(
+				"API rejected %s batch (HTTP 415), falling back to %s",
+				mode_name(mode), mode_name(next));
+			mode = next;
+			continue;
+		}
+
 		if (http_code >= 200 && http_code < 300) {
-			sr_log_info("SR %d posted to API (HTTP %ld)", sr_value,
-				    http_code);
-			success = true;
+			sent = events.size();
+			record_batch(events, mode, body.size());
 		} else {
-			sr_log_warn("API returned HTTP %ld for SR %d",
-				    http_code, sr_value);
+			sr_log_warn("API returned HTTP %ld for batch of %zu",
+				    http_code, events.size());
 		}
-	} else {
-		sr_log_warn("API request failed: %s",
-			    curl_easy_strerror(res));
+		break;
 	}
 
-	curl_slist_free_all(headers);
-	curl_easy_cleanup(curl);
-	return success;
+	std::lock_guard<std::mutex> lock(batch_mutex);
+	negotiated_mode = mode;
+
+	if (sent == events.size())
+		return true;
+
+	// Put unsent events back in front of anything queued meanwhile and
+	// retry once the batch ages out again
+	batch.insert(batch.begin(), events.begin() + sent, events.end());
+	trim_batch();
+	batch_started = (int64_t)std::time(nullptr);
+	return false;
 }
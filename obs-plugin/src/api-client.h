@@ -1,8 +1,53 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <memory>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cstdint>
 
+typedef void CURL;
+typedef void CURLM;
+struct curl_slist;
+
+enum class UploadMode {
+	Single = 0,      // one JSON object per request (legacy)
+	GzipJson = 1,    // gzip-compressed JSON array per batch
+	BinaryBatch = 2, // varint/delta-encoded binary per batch
+};
+
+struct SrEvent {
+	int sr;
+	int64_t timestamp;
+};
+
+// Request latency histogram: bucket i counts requests under 2^i ms, the
+// last bucket everything slower
+#define UPLOAD_LATENCY_BUCKETS 16
+
+struct UploadStats {
+	uint64_t events;
+	uint64_t requests;
+	uint64_t payload_bytes;
+	// What the same events would have cost as single JSON posts
+	uint64_t unbatched_bytes;
+	// Requests that got no HTTP response (refused, timed out, reset)
+	uint64_t failed_requests;
+	// Oldest pending events discarded past the pending cap
+	uint64_t dropped_events;
+	uint64_t latency_buckets[UPLOAD_LATENCY_BUCKETS];
+};
+
+/**
+ * Posts SR changes to the webapp. Requests run on a transport thread owned
+ * by the client, on one curl multi handle, so any of them can be aborted:
+ * callers block in send_sr()/flush_batch() only until their request
+ * completes or begin_shutdown()'s grace period ends. The transport thread
+ * is joined by the destructor, so nothing outlives the client.
+ */
 class ApiClient {
 public:
 	ApiClient();
@@ -12,12 +57,134 @@ public:
 	ApiClient &operator=(const ApiClient &) = delete;
 
 	void configure(const std::string &url, const std::string &api_key);
+	void configure_batching(UploadMode mode, size_t max_events,
+				int max_age_seconds);
 	bool send_sr(int sr_value);
+	/**
+	 * Like send_sr() but returns at once; the transport thread finishes
+	 * the request. Batched modes only queue the event, and the next
+	 * poll_batch() sends it.
+	 */
+	void send_sr_async(int sr_value);
 	bool is_configured() const;
 
+	/**
+	 * Bound how long teardown can take: requests still running after
+	 * grace_ms are aborted, and requests made after that fail at once.
+	 * Queued events are flushed right away, inside that window. Until it
+	 * ends the client works as usual, so a last drain_batch() can still
+	 * go out.
+	 */
+	void begin_shutdown(int grace_ms);
+
+	/**
+	 * Queue an event for batched upload. Flushes immediately once the
+	 * batch reaches its size bound; otherwise poll_batch() flushes it
+	 * when it ages out (or when send_sr_async() filled it).
+	 */
+	void queue_sr(int sr_value, int64_t timestamp);
+	void poll_batch();
+	/**
+	 * Post the oldest queued events, at most one batch's worth. Events
+	 * that didn't go out stay queued in order, and the oldest are dropped
+	 * once more than MAX_PENDING_EVENTS wait (counted in dropped_events).
+	 * Returns false if anything from this batch is still queued.
+	 */
+	bool flush_batch();
+	/**
+	 * Flush batch after batch until nothing is queued or a flush fails.
+	 * Returns true if the queue emptied.
+	 */
+	bool drain_batch();
+	size_t pending_events() const;
+
+	UploadStats get_stats() const;
+
+	/**
+	 * Keep each request's latency in ms until take_latencies(), for
+	 * exact percentiles rather than the histogram's power-of-two
+	 * buckets. Off by default; meant for benchmarks.
+	 */
+	void set_latency_recording(bool enabled);
+	std::vector<double> take_latencies();
+
 private:
-	std::string endpoint_url;
-	std::string auth_key;
+	/**
+	 * URL and request headers for one configuration, built once in
+	 * configure(). Requests hold a reference, so reconfiguring never
+	 * frees headers that are still on the wire.
+	 */
+	struct Endpoint {
+		std::string url;
+		curl_slist *json_headers;
+		curl_slist *gzip_headers;
+		curl_slist *binary_headers;
+
+		Endpoint();
+		~Endpoint();
+	};
+
+	/** One request, from submit() until the transport completes it */
+	struct Transfer {
+		CURL *curl;
+		std::shared_ptr<const Endpoint> endpoint;
+		std::string body; // async requests own their body
+		std::chrono::steady_clock::time_point started;
+		bool async;
+		int sr_value;
+		// Set by the transport thread (transport_mutex)
+		bool done;
+		int result; // CURLcode
+		long http_code;
+	};
+
+	std::shared_ptr<const Endpoint> get_endpoint() const;
+	bool prepare(Transfer &t, std::shared_ptr<const Endpoint> target,
+		     curl_slist *headers, const char *body, size_t size);
+	bool submit(Transfer *t);
+	bool post(const std::shared_ptr<const Endpoint> &target,
+		  curl_slist *headers, const char *body, size_t size,
+		  long *http_code);
+	void transport_loop();
+	void complete(Transfer *t, int result);
+	bool record_single(int sr_value, size_t size, long http_code);
+	size_t post_each(const std::shared_ptr<const Endpoint> &target,
+			 const std::vector<SrEvent> &events);
+	void record_batch(const std::vector<SrEvent> &events, UploadMode mode,
+			  size_t size);
+	bool encode_batch(const std::vector<SrEvent> &events, UploadMode mode,
+			  std::string &body) const;
+	void append_event(int sr_value, int64_t timestamp);
+	void trim_batch();
+
+	std::shared_ptr<const Endpoint> endpoint;
 	mutable std::mutex config_mutex;
 	bool curl_initialized;
+
+	// Batching (guarded by batch_mutex)
+	UploadMode upload_mode;
+	UploadMode negotiated_mode;
+	size_t batch_max_events;
+	int batch_max_age;
+	std::vector<SrEvent> batch;
+	int64_t batch_started;
+	UploadStats stats;
+	bool record_latencies;
+	std::vector<double> latencies;
+	mutable std::mutex batch_mutex;
+	std::mutex flush_mutex;
+
+	// Transport thread and its multi handle. The thread alone touches
+	// multi; others hand it requests through queued and wake it up.
+	CURLM *multi;
+	std::thread transport_thread;
+	std::vector<Transfer *> queued;
+	std::vector<Transfer *> active; // transport thread only
+	// Finished easy handles, reused so repeat posts skip handle setup
+	// and keep their connection alive
+	std::vector<CURL *> idle_handles;
+	bool stopping;
+	std::chrono::steady_clock::time_point abort_at;
+	std::mutex transport_mutex;
+	std::condition_variable transport_cv;
 };
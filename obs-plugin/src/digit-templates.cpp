@@ -0,0 +1,282 @@
+#include "digit-templates.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+// Highest Hamming distance accepted for a glyph match (~15% of bits)
+#define MATCH_MAX_DISTANCE 21
+// Best digit must beat the runner-up digit by this many bits
+#define MATCH_MIN_MARGIN 4
+// A learned glyph this close to an existing variant adds nothing
+#define LEARN_DUPLICATE_DISTANCE 4
+// Glyph aspect ratios must agree within this factor ("1" vs "7")
+#define ASPECT_TOLERANCE 1.3f
+// Ink runs shorter than this fraction of the tallest glyph are separators
+#define SEPARATOR_HEIGHT_RATIO 0.6f
+
+/* ------------------------------------------------------------------ */
+/* Glyph comparison                                                    */
+/* ------------------------------------------------------------------ */
+
+static int popcount64(uint64_t v)
+{
+	int n = 0;
+	while (v) {
+		v &= v - 1;
+		n++;
+	}
+	return n;
+}
+
+static int glyph_distance(const DigitGlyph &a, const DigitGlyph &b)
+{
+	float ratio = a.aspect > b.aspect ? a.aspect / b.aspect
+					  : b.aspect / a.aspect;
+	if (ratio > ASPECT_TOLERANCE)
+		return DIGIT_TEMPLATE_BITS;
+
+	return popcount64(a.bits[0] ^ b.bits[0]) +
+	       popcount64(a.bits[1] ^ b.bits[1]) +
+	       popcount64(a.bits[2] ^ b.bits[2]);
+}
+
+/* ------------------------------------------------------------------ */
+/* DigitTemplates                                                      */
+/* ------------------------------------------------------------------ */
+
+/*
+ * Binarize around the crop's own midpoint with the border deciding which
+ * side is ink, split on blank columns, and resample each tall-enough run
+ * into a template grid in glyphs. Returns false when there is nothing to
+ * read.
+ */
+bool DigitTemplates::segment(const uint8_t *gray, int width, int height) const
+{
+	glyphs.clear();
+	if (!gray || width <= 0 || height <= 0)
+		return false;
+
+	int lo = 255, hi = 0;
+	uint64_t border_sum = 0;
+	int border_count = 0;
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			int v = gray[y * width + x];
+			lo = std::min(lo, v);
+			hi = std::max(hi, v);
+			if (y == 0 || y == height - 1 || x == 0 ||
+			    x == width - 1) {
+				border_sum += v;
+				border_count++;
+			}
+		}
+	}
+	if (hi - lo < 32)
+		return false;
+
+	int mid = (lo + hi) / 2;
+	bool light_ink = border_sum < (uint64_t)border_count * mid;
+
+	ink.resize((size_t)width * height);
+	column_ink.assign(width, 0);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			int v = gray[y * width + x];
+			bool on = light_ink ? v > mid : v < mid;
+			ink[y * width + x] = on;
+			column_ink[x] += on;
+		}
+	}
+
+	runs.clear();
+	int tallest = 0;
+
+	for (int x = 0; x < width;) {
+		if (!column_ink[x]) {
+			x++;
+			continue;
+		}
+
+		InkRun r = {x, x, height, 0};
+		while (x < width && column_ink[x])
+			x++;
+		r.x1 = x;
+
+		for (int y = 0; y < height; y++) {
+			const uint8_t *row = ink.data() + y * width;
+			for (int cx = r.x0; cx < r.x1; cx++) {
+				if (row[cx]) {
+					r.y0 = std::min(r.y0, y);
+					r.y1 = std::max(r.y1, y + 1);
+					break;
+				}
+			}
+		}
+
+		tallest = std::max(tallest, r.y1 - r.y0);
+		runs.push_back(r);
+	}
+
+	if (runs.empty() || tallest < 5)
+		return false;
+
+	for (const InkRun &r : runs) {
+		int rw = r.x1 - r.x0;
+		int rh = r.y1 - r.y0;
+		if (rh < tallest * SEPARATOR_HEIGHT_RATIO)
+			continue;
+
+		// A run touching the crop edge may be a cut-off glyph
+		if (r.x0 == 0 || r.x1 == width)
+			return false;
+
+		DigitGlyph g = {};
+		g.aspect = (float)rw / (float)rh;
+
+		// Grid cell edges in crop pixels
+		int xs[DIGIT_TEMPLATE_W + 1];
+		int ys[DIGIT_TEMPLATE_H + 1];
+		for (int i = 0; i <= DIGIT_TEMPLATE_W; i++)
+			xs[i] = r.x0 + i * rw / DIGIT_TEMPLATE_W;
+		for (int i = 0; i <= DIGIT_TEMPLATE_H; i++)
+			ys[i] = r.y0 + i * rh / DIGIT_TEMPLATE_H;
+
+		for (int gy = 0; gy < DIGIT_TEMPLATE_H; gy++) {
+			int ya = ys[gy];
+			int yb = std::max(ys[gy + 1], ya + 1);
+
+			for (int gx = 0; gx < DIGIT_TEMPLATE_W; gx++) {
+				int xa = xs[gx];
+				int xb = std::max(xs[gx + 1], xa + 1);
+
+				int on = 0;
+				for (int y = ya; y < yb; y++)
+					for (int x = xa; x < xb; x++)
+						on += ink[y * width + x];
+
+				// Majority vote over the cell
+				if (on * 2 >= (yb - ya) * (xb - xa)) {
+					int bit = gy * DIGIT_TEMPLATE_W + gx;
+					g.bits[bit / 64] |= 1ULL << (bit % 64);
+				}
+			}
+		}
+
+		glyphs.push_back(g);
+	}
+
+	return !glyphs.empty();
+}
+
+DigitTemplates::DigitTemplates() : learned(0)
+{
+	clear();
+}
+
+void DigitTemplates::clear()
+{
+	memset(&set, 0, sizeof(set));
+	learned++;
+}
+
+void DigitTemplates::assign(const DigitTemplateSet &data)
+{
+	set = data;
+	for (int d = 0; d < 10; d++) {
+		set.count[d] = std::min<uint8_t>(set.count[d],
+						 DIGIT_TEMPLATE_VARIANTS);
+		set.next[d] %= DIGIT_TEMPLATE_VARIANTS;
+	}
+	learned++;
+}
+
+bool DigitTemplates::empty() const
+{
+	for (int d = 0; d < 10; d++) {
+		if (set.count[d])
+			return false;
+	}
+	return true;
+}
+
+void DigitTemplates::learn(const uint8_t *gray, int width, int height,
+			   int value)
+{
+	if (value < 0)
+		return;
+
+	if (!segment(gray, width, height))
+		return;
+
+	// Only learn when segmentation agrees with the known digit count
+	char digits[16];
+	char *end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+	if (glyphs.size() != (size_t)(end - digits))
+		return;
+
+	for (size_t i = 0; i < glyphs.size(); i++) {
+		int d = digits[i] - '0';
+
+		bool known = false;
+		for (int v = 0; v < set.count[d]; v++) {
+			if (glyph_distance(glyphs[i], set.glyphs[d][v]) <=
+			    LEARN_DUPLICATE_DISTANCE) {
+				known = true;
+				break;
+			}
+		}
+		if (known)
+			continue;
+
+		int slot = set.next[d];
+		set.glyphs[d][slot] = glyphs[i];
+		set.next[d] = (uint8_t)((slot + 1) % DIGIT_TEMPLATE_VARIANTS);
+		if (set.count[d] < DIGIT_TEMPLATE_VARIANTS)
+			set.count[d]++;
+		learned++;
+	}
+}
+
+bool DigitTemplates::match(const uint8_t *gray, int width, int height,
+			   int &value, int &confidence) const
+{
+	if (!segment(gray, width, height) || glyphs.size() > 5)
+		return false;
+
+	int result = 0;
+	int worst = 0;
+
+	for (const DigitGlyph &g : glyphs) {
+		int best_digit = -1;
+		int best = DIGIT_TEMPLATE_BITS + 1;
+		int runner_up = DIGIT_TEMPLATE_BITS + 1;
+
+		for (int d = 0; d < 10; d++) {
+			int digit_best = DIGIT_TEMPLATE_BITS + 1;
+			for (int v = 0; v < set.count[d]; v++)
+				digit_best = std::min(
+					digit_best,
+					glyph_distance(g, set.glyphs[d][v]));
+
+			if (digit_best < best) {
+				runner_up = best;
+				best = digit_best;
+				best_digit = d;
+			} else if (digit_best < runner_up) {
+				runner_up = digit_best;
+			}
+		}
+
+		if (best_digit < 0 || best > MATCH_MAX_DISTANCE ||
+		    runner_up - best < MATCH_MIN_MARGIN)
+			return false;
+
+		result = result * 10 + best_digit;
+		worst = std::max(worst, best);
+	}
+
+	value = result;
+	confidence = 100 - worst * 100 / DIGIT_TEMPLATE_BITS;
+	return true;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Glyphs are resampled to this grid before matching
+#define DIGIT_TEMPLATE_W 10
+#define DIGIT_TEMPLATE_H 14
+#define DIGIT_TEMPLATE_BITS (DIGIT_TEMPLATE_W * DIGIT_TEMPLATE_H)
+// Variants kept per digit (fonts, sizes, HUD scaling)
+#define DIGIT_TEMPLATE_VARIANTS 4
+
+struct DigitGlyph {
+	uint64_t bits[3]; // DIGIT_TEMPLATE_BITS, row-major
+	float aspect;     // width / height of the glyph's ink box
+};
+
+struct DigitTemplateSet {
+	DigitGlyph glyphs[10][DIGIT_TEMPLATE_VARIANTS];
+	uint8_t count[10];
+	uint8_t next[10]; // variant replaced on the next learn()
+};
+
+/**
+ * Per-digit bitmap templates learned from Tesseract-confirmed crops.
+ *
+ * A crop is binarized, split into glyphs on blank columns (dropping the
+ * short thousands separator) and each glyph is compared against the learned
+ * variants by Hamming distance. Matching a crop costs microseconds, so it
+ * can answer before Tesseract does. Not thread-safe; the owning OcrEngine
+ * is only used from one thread at a time.
+ */
+class DigitTemplates {
+public:
+	DigitTemplates();
+
+	/** Learn glyphs from a crop whose value is known to be value */
+	void learn(const uint8_t *gray, int width, int height, int value);
+
+	/**
+	 * Read a crop with the learned templates.
+	 * @param confidence Out: 0-100, from the worst glyph's distance
+	 * @return false unless every glyph matches one digit unambiguously
+	 */
+	bool match(const uint8_t *gray, int width, int height, int &value,
+		   int &confidence) const;
+
+	void clear();
+	bool empty() const;
+
+	/** Changes whenever learn() adds or replaces a variant */
+	uint64_t revision() const { return learned; }
+
+	const DigitTemplateSet &data() const { return set; }
+	void assign(const DigitTemplateSet &data);
+
+private:
+	struct InkRun {
+		int x0, x1, y0, y1;
+	};
+
+	bool segment(const uint8_t *gray, int width, int height) const;
+
+	DigitTemplateSet set;
+	uint64_t learned;
+
+	// Segmentation buffers, reused so steady-state matching doesn't
+	// allocate
+	mutable std::vector<uint8_t> ink;
+	mutable std::vector<int> column_ink;
+	mutable std::vector<InkRun> runs;
+	mutable std::vector<DigitGlyph> glyphs;
+};
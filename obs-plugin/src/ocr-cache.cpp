@@ -0,0 +1,284 @@
+#include "ocr-cache.h"
+#include "plugin-support.h"
+
+#include <util/platform.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#define OCR_CACHE_MAGIC "SRC1"
+
+uint64_t ocr_crop_hash(const uint8_t *gray, int width, int height)
+{
+	const size_t n = (size_t)width * height;
+
+	uint8_t lo = 255, hi = 0;
+	for (size_t i = 0; i < n; i++) {
+		lo = std::min(lo, gray[i]);
+		hi = std::max(hi, gray[i]);
+	}
+	const uint8_t threshold = (uint8_t)((lo + hi + 1) / 2);
+
+	// FNV-1a over the dimensions, then the binarized pixels packed 8 per
+	// byte
+	uint64_t h = 1469598103934665603ULL;
+	auto mix = [&h](uint8_t byte) {
+		h ^= byte;
+		h *= 1099511628211ULL;
+	};
+
+	for (int shift = 0; shift < 32; shift += 8) {
+		mix((uint8_t)(width >> shift));
+		mix((uint8_t)(height >> shift));
+	}
+
+	uint8_t packed = 0;
+	for (size_t i = 0; i < n; i++) {
+		packed = (uint8_t)((packed << 1) | (gray[i] >= threshold));
+		if ((i & 7) == 7) {
+			mix(packed);
+			packed = 0;
+		}
+	}
+	mix(packed);
+
+	return h;
+}
+
+#define OCR_CACHE_NIL UINT32_MAX
+
+OcrCache::OcrCache(size_t capacity_)
+	: capacity(capacity_ > 0 ? capacity_ : 1),
+	  used(0),
+	  newest(OCR_CACHE_NIL),
+	  oldest(OCR_CACHE_NIL),
+	  hits(0),
+	  misses(0),
+	  inserts(0)
+{
+	size_t slots = 1;
+	while (slots < capacity * 2)
+		slots <<= 1;
+
+	entries.resize(capacity);
+	index.assign(slots, OCR_CACHE_NIL);
+}
+
+/* Keys are already hashes: fold the halves together and mask */
+static size_t home_slot(uint64_t key, size_t mask)
+{
+	return (size_t)(key ^ (key >> 32)) & mask;
+}
+
+/* Slot holding key, or the empty slot where it would go */
+size_t OcrCache::find_slot(uint64_t key) const
+{
+	size_t mask = index.size() - 1;
+	size_t slot = home_slot(key, mask);
+
+	while (index[slot] != OCR_CACHE_NIL && entries[index[slot]].key != key)
+		slot = (slot + 1) & mask;
+	return slot;
+}
+
+/* Empty a slot, shifting later probes back so none becomes unreachable */
+void OcrCache::erase_slot(size_t slot)
+{
+	size_t mask = index.size() - 1;
+	size_t hole = slot;
+
+	for (size_t i = (slot + 1) & mask; index[i] != OCR_CACHE_NIL;
+	     i = (i + 1) & mask) {
+		size_t home = home_slot(entries[index[i]].key, mask);
+
+		// Movable if the hole lies between its home slot and i
+		if (((i - home) & mask) >= ((i - hole) & mask)) {
+			index[hole] = index[i];
+			hole = i;
+		}
+	}
+	index[hole] = OCR_CACHE_NIL;
+}
+
+void OcrCache::unlink(uint32_t e)
+{
+	Entry &entry = entries[e];
+	if (entry.newer != OCR_CACHE_NIL)
+		entries[entry.newer].older = entry.older;
+	else
+		newest = entry.older;
+	if (entry.older != OCR_CACHE_NIL)
+		entries[entry.older].newer = entry.newer;
+	else
+		oldest = entry.newer;
+}
+
+void OcrCache::push_front(uint32_t e)
+{
+	Entry &entry = entries[e];
+	entry.newer = OCR_CACHE_NIL;
+	entry.older = newest;
+	if (newest != OCR_CACHE_NIL)
+		entries[newest].newer = e;
+	newest = e;
+	if (oldest == OCR_CACHE_NIL)
+		oldest = e;
+}
+
+bool OcrCache::lookup(uint64_t key, int &value, int &confidence)
+{
+	std::lock_guard<std::mutex> lock(cache_mutex);
+
+	uint32_t e = index[find_slot(key)];
+	if (e == OCR_CACHE_NIL) {
+		misses++;
+		return false;
+	}
+
+	// Move to front: most recently used
+	unlink(e);
+	push_front(e);
+	value = entries[e].value;
+	confidence = entries[e].confidence;
+	hits++;
+	return true;
+}
+
+void OcrCache::insert(uint64_t key, int value, int confidence)
+{
+	if (confidence < OCR_CACHE_MIN_CONFIDENCE)
+		return;
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	insert_locked(key, value, confidence);
+	inserts++;
+}
+
+void OcrCache::insert_locked(uint64_t key, int value, int confidence)
+{
+	size_t slot = find_slot(key);
+	uint32_t e = index[slot];
+
+	if (e == OCR_CACHE_NIL) {
+		if (used < capacity) {
+			e = (uint32_t)used++;
+		} else {
+			// Full: recycle the least recently used entry
+			e = oldest;
+			unlink(e);
+			erase_slot(find_slot(entries[e].key));
+			slot = find_slot(key);
+		}
+		entries[e].key = key;
+		index[slot] = e;
+	} else {
+		unlink(e);
+	}
+
+	entries[e].value = value;
+	entries[e].confidence = confidence;
+	push_front(e);
+}
+
+void OcrCache::clear()
+{
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	std::fill(index.begin(), index.end(), OCR_CACHE_NIL);
+	used = 0;
+	newest = OCR_CACHE_NIL;
+	oldest = OCR_CACHE_NIL;
+}
+
+OcrCacheStats OcrCache::stats() const
+{
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	return {hits, misses, inserts, used};
+}
+
+/*
+ * File layout: "SRC1", uint32 count, then count entries of
+ * (uint64 key, int32 value, int32 confidence), least recently used first so
+ * that loading restores the same LRU order.
+ */
+bool OcrCache::save(const std::string &path) const
+{
+	std::vector<Entry> saved;
+	{
+		std::lock_guard<std::mutex> lock(cache_mutex);
+		saved.reserve(used);
+		for (uint32_t e = oldest; e != OCR_CACHE_NIL;
+		     e = entries[e].newer)
+			saved.push_back(entries[e]);
+	}
+
+	std::string tmp = path + ".tmp";
+	FILE *f = fopen(tmp.c_str(), "wb");
+	if (!f)
+		return false;
+
+	uint32_t count = (uint32_t)saved.size();
+	bool ok = fwrite(OCR_CACHE_MAGIC, 1, 4, f) == 4 &&
+		  fwrite(&count, sizeof(count), 1, f) == 1;
+	for (const Entry &e : saved) {
+		int32_t v = e.value, c = e.confidence;
+		ok = ok && fwrite(&e.key, sizeof(e.key), 1, f) == 1 &&
+		     fwrite(&v, sizeof(v), 1, f) == 1 &&
+		     fwrite(&c, sizeof(c), 1, f) == 1;
+	}
+	ok = (fclose(f) == 0) && ok;
+
+	// A crash mid-write leaves the previous file intact
+	if (!ok || os_safe_replace(path.c_str(), tmp.c_str(), nullptr) != 0) {
+		os_unlink(tmp.c_str());
+		sr_log_warn("OCR cache: failed to save %s", path.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool OcrCache::load(const std::string &path)
+{
+	FILE *f = fopen(path.c_str(), "rb");
+	if (!f)
+		return false;
+
+	char magic[4];
+	uint32_t count = 0;
+	bool ok = fread(magic, 1, 4, f) == 4 &&
+		  std::memcmp(magic, OCR_CACHE_MAGIC, 4) == 0 &&
+		  fread(&count, sizeof(count), 1, f) == 1;
+
+	size_t loaded = 0, skipped = 0;
+	if (ok) {
+		std::lock_guard<std::mutex> lock(cache_mutex);
+		for (uint32_t i = 0; i < count; i++) {
+			uint64_t key;
+			int32_t v, c;
+			if (fread(&key, sizeof(key), 1, f) != 1 ||
+			    fread(&v, sizeof(v), 1, f) != 1 ||
+			    fread(&c, sizeof(c), 1, f) != 1)
+				break;
+
+			// The file is outside our control: only take entries
+			// insert() itself would have stored
+			if (v < 0 || v > OCR_MAX_SR || c > 100 ||
+			    c < OCR_CACHE_MIN_CONFIDENCE) {
+				skipped++;
+				continue;
+			}
+			insert_locked(key, v, c);
+			loaded++;
+		}
+	}
+	fclose(f);
+
+	if (skipped)
+		sr_log_warn("OCR cache: skipped %zu invalid entries in %s",
+			    skipped, path.c_str());
+	if (ok)
+		sr_log_info("OCR cache: loaded %zu entries from %s", loaded,
+			    path.c_str());
+	return ok;
+}
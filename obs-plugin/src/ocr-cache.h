@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+// Only recognitions at or above this confidence are cached
+#define OCR_CACHE_MIN_CONFIDENCE 80
+// Largest SR value OCR accepts; anything above is a misread
+#define OCR_MAX_SR 99999
+#define OCR_CACHE_DEFAULT_CAPACITY 256
+
+struct OcrCacheStats {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t inserts;
+	size_t entries;
+};
+
+/**
+ * Hash a grayscale crop after binarizing it around its own midpoint, so
+ * the same digits rendered under slightly different brightness map to the
+ * same key.
+ */
+uint64_t ocr_crop_hash(const uint8_t *gray, int width, int height);
+
+/**
+ * Bounded LRU map from normalized crop hash to recognized SR value.
+ * Thread-safe; lookups and inserts are O(1). All storage is allocated by
+ * the constructor, so a full cache recycles its least recently used slot
+ * instead of touching the heap.
+ */
+class OcrCache {
+public:
+	explicit OcrCache(size_t capacity = OCR_CACHE_DEFAULT_CAPACITY);
+
+	bool lookup(uint64_t key, int &value, int &confidence);
+	void insert(uint64_t key, int value, int confidence);
+	void clear();
+
+	OcrCacheStats stats() const;
+
+	bool save(const std::string &path) const;
+	bool load(const std::string &path);
+
+private:
+	struct Entry {
+		uint64_t key;
+		int value;
+		int confidence;
+		uint32_t newer; // LRU links: entry indices or OCR_CACHE_NIL
+		uint32_t older;
+	};
+
+	void insert_locked(uint64_t key, int value, int confidence);
+	size_t find_slot(uint64_t key) const;
+	void erase_slot(size_t slot);
+	void unlink(uint32_t e);
+	void push_front(uint32_t e);
+
+	size_t capacity;
+	std::vector<Entry> entries; // [0, used) hold cached values
+	size_t used;
+	uint32_t newest;
+	uint32_t oldest;
+	// Open addressing with linear probing: entry index or OCR_CACHE_NIL,
+	// at least twice capacity so probes stay short and always end
+	std::vector<uint32_t> index;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t inserts;
+	mutable std::mutex cache_mutex;
+};
@@ -1,15 +1,126 @@
 #include "ocr-engine.h"
 #include "plugin-support.h"
+#include "trace.h"
+#include "alloc-counter.h"
 
 #include <tesseract/baseapi.h>
+#include <tesseract/resultiterator.h>
 #include <leptonica/allheaders.h>
 
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <charconv>
 #include <cstring>
 
-OcrEngine::OcrEngine() : tess_api(nullptr), initialized(false) {}
+/* ------------------------------------------------------------------ */
+/* Helpers                                                             */
+/* ------------------------------------------------------------------ */
+
+static void to_grayscale(const uint8_t *bgra_data, int linesize,
+			 const OcrRegion &region, uint8_t *gray)
+{
+	for (int row = 0; row < region.height; row++) {
+		const uint8_t *src =
+			bgra_data + (region.y + row) * linesize + region.x * 4;
+		uint8_t *dst = gray + row * region.width;
+
+		for (int col = 0; col < region.width; col++) {
+			uint8_t b = src[col * 4 + 0];
+			uint8_t g = src[col * 4 + 1];
+			uint8_t r = src[col * 4 + 2];
+			// Standard luminance weights
+			dst[col] = static_cast<uint8_t>(0.299f * r + 0.587f * g +
+							0.114f * b);
+		}
+	}
+}
+
+/* Strip commas, spaces and newlines from OCR text and parse the SR value */
+static bool parse_sr(const char *raw, int &sr_value)
+{
+	char cleaned[16];
+	size_t len = 0;
+	for (const char *c = raw; *c; c++) {
+		if (*c < '0' || *c > '9')
+			continue;
+		if (len == sizeof(cleaned)) {
+			sr_log_warn("OCR parse failed: too many digits in '%s'",
+				    raw);
+			return false;
+		}
+		cleaned[len++] = *c;
+	}
+
+	if (!len) {
+		sr_log_debug("OCR produced no digits (raw: '%s')", raw);
+		return false;
+	}
+
+	auto res = std::from_chars(cleaned, cleaned + len, sr_value);
+	if (res.ec != std::errc()) {
+		sr_log_warn("OCR parse failed: '%.*s'", (int)len, cleaned);
+		return false;
+	}
+
+	// Sanity check: SR values are typically 0-10000
+	if (sr_value < 0 || sr_value > OCR_MAX_SR) {
+		sr_log_warn("OCR value out of range: %d", sr_value);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Stretch a grayscale crop to the full 0-255 range with dark text on a light
+ * background, so crops with different HUD colors share one binarization when
+ * stacked. The border pixels decide which polarity is background.
+ * Returns false for a flat crop with nothing to read.
+ */
+static bool normalize_crop(uint8_t *gray, int width, int height)
+{
+	int lo = 255, hi = 0;
+	uint64_t border_sum = 0;
+	int border_count = 0;
+
+	for (int y = 0; y < height; y++) {
+		const uint8_t *row = gray + y * width;
+		for (int x = 0; x < width; x++) {
+			lo = std::min(lo, (int)row[x]);
+			hi = std::max(hi, (int)row[x]);
+			if (y == 0 || y == height - 1 || x == 0 ||
+			    x == width - 1) {
+				border_sum += row[x];
+				border_count++;
+			}
+		}
+	}
+
+	if (hi - lo < 16)
+		return false;
+
+	bool invert = border_sum < (uint64_t)border_count * (lo + hi) / 2;
+	int range = hi - lo;
+
+	for (int i = 0; i < width * height; i++) {
+		int v = (gray[i] - lo) * 255 / range;
+		gray[i] = (uint8_t)(invert ? 255 - v : v);
+	}
+	return true;
+}
+
+/* ------------------------------------------------------------------ */
+/* OcrEngine                                                           */
+/* ------------------------------------------------------------------ */
+
+OcrEngine::OcrEngine()
+	: fast_region{0, 0, 0, 0},
+	  fast_key(0),
+	  tess_api(nullptr),
+	  initialized(false)
+{
+}
 
 OcrEngine::~OcrEngine()
 {
@@ -57,7 +168,7 @@ void OcrEngine::shutdown()
 }
 
 int OcrEngine::recognize(const uint8_t *bgra_data, int linesize,
-			 const OcrRegion &region)
+			 const OcrRegion &region, int *out_confidence)
 {
 	if (!initialized || !bgra_data)
 		return -1;
@@ -65,31 +176,98 @@ int OcrEngine::recognize(const uint8_t *bgra_data, int linesize,
 	if (region.width <= 0 || region.height <= 0)
 		return -1;
 
-	// Convert BGRA region to grayscale
-	std::vector<uint8_t> gray(region.width * region.height);
+	// Convert BGRA region to grayscale (buffer reused across calls)
+	std::vector<uint8_t> &gray = gray_buffer;
+	gray.resize(region.width * region.height);
+	to_grayscale(bgra_data, linesize, region, gray.data());
 
-	for (int row = 0; row < region.height; row++) {
-		const uint8_t *src =
-			bgra_data + (region.y + row) * linesize + region.x * 4;
-		uint8_t *dst = gray.data() + row * region.width;
+	// Same digits render to the same pixels: skip Tesseract on a repeat
+	uint64_t crop_key = ocr_crop_hash(gray.data(), region.width,
+					  region.height);
+	int cached_value = -1;
+	int cached_confidence = 0;
+	if (result_cache.lookup(crop_key, cached_value, cached_confidence)) {
+		sr_log_debug("OCR cache hit: %d", cached_value);
+		if (out_confidence)
+			*out_confidence = cached_confidence;
+		return cached_value;
+	}
 
-		for (int col = 0; col < region.width; col++) {
-			uint8_t b = src[col * 4 + 0];
-			uint8_t g = src[col * 4 + 1];
-			uint8_t r = src[col * 4 + 2];
-			// Standard luminance weights
-			dst[col] = static_cast<uint8_t>(0.299f * r + 0.587f * g +
-							0.114f * b);
-		}
+	return run_tesseract(gray.data(), region.width, region.height,
+			     crop_key, out_confidence);
+}
+
+int OcrEngine::recognize_fast(const uint8_t *bgra_data, int linesize,
+			      const OcrRegion &region, bool &provisional,
+			      int *out_confidence)
+{
+	provisional = false;
+	fast_gray.clear();
+
+	if (!initialized || !bgra_data)
+		return -1;
+
+	if (region.width <= 0 || region.height <= 0)
+		return -1;
+
+	fast_region = region;
+	fast_gray.resize(region.width * region.height);
+	to_grayscale(bgra_data, linesize, region, fast_gray.data());
+
+	fast_key = ocr_crop_hash(fast_gray.data(), region.width,
+				 region.height);
+	int value = -1;
+	int confidence = 0;
+	if (result_cache.lookup(fast_key, value, confidence)) {
+		sr_log_debug("OCR cache hit: %d", value);
+	} else if (templates.match(fast_gray.data(), region.width,
+				   region.height, value, confidence)) {
+		sr_log_debug("OCR template match: %d (provisional)", value);
+		provisional = true;
+	} else {
+		return -1;
 	}
 
-	auto *api = static_cast<tesseract::TessBaseAPI *>(tess_api);
+	if (out_confidence)
+		*out_confidence = confidence;
+	return value;
+}
+
+int OcrEngine::verify(int *out_confidence)
+{
+	if (!initialized || fast_gray.empty())
+		return -1;
 
-	api->SetImage(gray.data(), region.width, region.height, 1,
-		      region.width);
+	return run_tesseract(fast_gray.data(), fast_region.width,
+			     fast_region.height, fast_key, out_confidence);
+}
 
-	char *text = api->GetUTF8Text();
-	int confidence = api->MeanTextConf();
+/* Confident results feed both the crop cache and the digit templates */
+void OcrEngine::remember(const uint8_t *gray, int width, int height,
+			 uint64_t crop_key, int value, int confidence)
+{
+	result_cache.insert(crop_key, value, confidence);
+	if (confidence >= OCR_CACHE_MIN_CONFIDENCE)
+		templates.learn(gray, width, height, value);
+}
+
+int OcrEngine::run_tesseract(const uint8_t *gray, int width, int height,
+			     uint64_t crop_key, int *out_confidence)
+{
+	auto *api = static_cast<tesseract::TessBaseAPI *>(tess_api);
+
+	uint64_t tess_begin = sr_trace_now_ns();
+	char *text;
+	int confidence;
+	{
+		// Tesseract's own allocations are not ours to remove
+		SrAllocPause pause;
+		api->SetImage(gray, width, height, 1, width);
+		text = api->GetUTF8Text();
+		confidence = api->MeanTextConf();
+		api->Clear();
+	}
+	sr_trace_event("tesseract", tess_begin, sr_trace_now_ns());
 
 	if (!text) {
 		sr_log_warn("OCR returned null text");
@@ -99,41 +277,180 @@ int OcrEngine::recognize(const uint8_t *bgra_data, int linesize,
 	if (confidence < 50) {
 		sr_log_debug("OCR low confidence (%d): '%s'", confidence, text);
 		delete[] text;
-		api->Clear();
 		return -1;
 	}
 
 	// Parse the result: strip commas and whitespace, convert to integer
-	std::string raw(text);
+	int sr_value = 0;
+	bool parsed = parse_sr(text, sr_value);
 	delete[] text;
-	api->Clear();
 
-	// Remove commas, spaces, newlines
-	std::string cleaned;
-	for (char c : raw) {
-		if (c >= '0' && c <= '9')
-			cleaned += c;
+	if (!parsed)
+		return -1;
+
+	sr_log_debug("OCR result: %d (confidence: %d)", sr_value, confidence);
+	remember(gray, width, height, crop_key, sr_value, confidence);
+	if (out_confidence)
+		*out_confidence = confidence;
+	return sr_value;
+}
+
+/* ------------------------------------------------------------------ */
+/* Batch recognition                                                   */
+/* ------------------------------------------------------------------ */
+
+struct PendingCrop {
+	size_t index; // into the caller's crop list
+	uint64_t key;
+	std::vector<uint8_t> gray;
+	int width;
+	int height;
+	std::string text;
+	float confidence;
+	bool seen;
+};
+
+std::vector<OcrResult>
+OcrEngine::recognize_batch(const std::vector<OcrCrop> &crops)
+{
+	std::vector<OcrResult> results(crops.size(), OcrResult{-1, 0});
+	if (!initialized)
+		return results;
+
+	// Serve repeats from the cache; only misses go to Tesseract
+	std::vector<PendingCrop> pending;
+	for (size_t i = 0; i < crops.size(); i++) {
+		const OcrCrop &crop = crops[i];
+		const OcrRegion &region = crop.region;
+		if (!crop.bgra_data || region.width <= 0 || region.height <= 0)
+			continue;
+
+		PendingCrop p = {};
+		p.index = i;
+		p.width = region.width;
+		p.height = region.height;
+		p.gray.resize(region.width * region.height);
+		to_grayscale(crop.bgra_data, crop.linesize, region,
+			     p.gray.data());
+
+		p.key = ocr_crop_hash(p.gray.data(), p.width, p.height);
+		OcrResult &out = results[i];
+		if (result_cache.lookup(p.key, out.value, out.confidence))
+			continue;
+		pending.push_back(std::move(p));
 	}
 
-	if (cleaned.empty()) {
-		sr_log_debug("OCR produced no digits (raw: '%s')", raw.c_str());
-		return -1;
+	// A lone miss reads best in single-line mode; no stitching needed.
+	// Its crop is already converted and looked up, so go straight to
+	// Tesseract as recognize() would.
+	if (pending.size() == 1) {
+		PendingCrop &p = pending[0];
+		OcrResult &out = results[p.index];
+		out.value = run_tesseract(p.gray.data(), p.width, p.height,
+					  p.key, &out.confidence);
+		if (out.value < 0)
+			out.confidence = 0;
+		return results;
 	}
 
-	int sr_value = 0;
-	try {
-		sr_value = std::stoi(cleaned);
-	} catch (...) {
-		sr_log_warn("OCR parse failed: '%s'", cleaned.c_str());
-		return -1;
+	// Stitched crops must share polarity and contrast; drop blank ones
+	pending.erase(std::remove_if(pending.begin(), pending.end(),
+				     [](PendingCrop &p) {
+					     return !normalize_crop(
+						     p.gray.data(), p.width,
+						     p.height);
+				     }),
+		      pending.end());
+	if (pending.empty())
+		return results;
+
+	/*
+	 * Stack the crops vertically on a white canvas. Each crop owns a band
+	 * of equal height, with a margin of blank rows so Tesseract never
+	 * merges neighbouring crops into one text line.
+	 */
+	int max_width = 0, max_height = 0;
+	for (const PendingCrop &p : pending) {
+		max_width = std::max(max_width, p.width);
+		max_height = std::max(max_height, p.height);
 	}
 
-	// Sanity check: SR values are typically 0-10000
-	if (sr_value < 0 || sr_value > 99999) {
-		sr_log_warn("OCR value out of range: %d", sr_value);
-		return -1;
+	int margin = std::max(8, max_height / 2);
+	int band = max_height + margin;
+	int canvas_w = max_width + margin * 2;
+	int canvas_h = band * (int)pending.size() + margin;
+	std::vector<uint8_t> canvas((size_t)canvas_w * canvas_h, 255);
+
+	for (size_t n = 0; n < pending.size(); n++) {
+		const PendingCrop &p = pending[n];
+		int top = margin + (int)n * band + (max_height - p.height) / 2;
+		for (int row = 0; row < p.height; row++)
+			memcpy(canvas.data() + (top + row) * canvas_w + margin,
+			       p.gray.data() + row * p.width, p.width);
 	}
 
-	sr_log_debug("OCR result: %d (confidence: %d)", sr_value, confidence);
-	return sr_value;
+	auto *api = static_cast<tesseract::TessBaseAPI *>(tess_api);
+
+	uint64_t tess_begin = sr_trace_now_ns();
+	api->SetPageSegMode(tesseract::PSM_SINGLE_BLOCK);
+	api->SetImage(canvas.data(), canvas_w, canvas_h, 1, canvas_w);
+
+	if (api->Recognize(nullptr) == 0) {
+		tesseract::ResultIterator *it = api->GetIterator();
+		const auto level = tesseract::RIL_TEXTLINE;
+
+		if (it) {
+			do {
+				if (it->Empty(level))
+					continue;
+
+				int left, top, right, bottom;
+				if (!it->BoundingBox(level, &left, &top, &right,
+						     &bottom))
+					continue;
+
+				// Band of the line's vertical center
+				int center = (top + bottom) / 2 - margin / 2;
+				int n = center / band;
+				if (center < 0 || n >= (int)pending.size())
+					continue;
+
+				char *line = it->GetUTF8Text(level);
+				if (!line)
+					continue;
+
+				// A wide gap can split one crop into two lines
+				PendingCrop &p = pending[n];
+				float conf = it->Confidence(level);
+				p.text += line;
+				p.confidence = p.seen ? std::min(p.confidence, conf)
+						      : conf;
+				p.seen = true;
+				delete[] line;
+			} while (it->Next(level));
+			delete it;
+		}
+	}
+
+	api->Clear();
+	api->SetPageSegMode(tesseract::PSM_SINGLE_LINE);
+	sr_trace_event("tesseract_batch", tess_begin, sr_trace_now_ns());
+
+	for (const PendingCrop &p : pending) {
+		int confidence = (int)p.confidence;
+		if (!p.seen || confidence < 50)
+			continue;
+
+		int sr_value = 0;
+		if (!parse_sr(p.text.c_str(), sr_value))
+			continue;
+
+		remember(p.gray.data(), p.width, p.height, p.key, sr_value,
+			 confidence);
+		results[p.index] = {sr_value, confidence};
+	}
+
+	sr_log_debug("OCR batch: %zu crops, %zu sent to Tesseract",
+		     crops.size(), pending.size());
+	return results;
 }
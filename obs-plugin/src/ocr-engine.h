@@ -2,6 +2,10 @@
 
 #include <string>
 #include <cstdint>
+#include <vector>
+
+#include "ocr-cache.h"
+#include "digit-templates.h"
 
 struct OcrRegion {
 	int x;
@@ -10,6 +14,18 @@ struct OcrRegion {
 	int height;
 };
 
+/** One crop queued for batch recognition */
+struct OcrCrop {
+	const uint8_t *bgra_data;
+	int linesize;
+	OcrRegion region;
+};
+
+struct OcrResult {
+	int value;      // -1 on failure/low confidence
+	int confidence; // 0-100
+};
+
 class OcrEngine {
 public:
 	OcrEngine();
@@ -27,12 +43,62 @@ public:
 	 * @param bgra_data  Pointer to the full frame BGRA pixels
 	 * @param linesize   Bytes per row in the full frame
 	 * @param region     Sub-region to OCR within the frame
+	 * @param confidence Optional out: mean Tesseract confidence (0-100)
 	 * @return Parsed SR integer, or -1 on failure/low confidence
 	 */
 	int recognize(const uint8_t *bgra_data, int linesize,
-		      const OcrRegion &region);
+		      const OcrRegion &region, int *confidence = nullptr);
+
+	/**
+	 * Cheap first pass: the result cache, then the learned digit
+	 * templates. Keeps a copy of the crop for verify().
+	 * @param provisional Out: true when the value came from templates and
+	 *                    still needs verify() to confirm it
+	 * @return Parsed SR integer, or -1 when only Tesseract can tell
+	 */
+	int recognize_fast(const uint8_t *bgra_data, int linesize,
+			   const OcrRegion &region, bool &provisional,
+			   int *confidence = nullptr);
+
+	/**
+	 * Run Tesseract on the crop kept by the last recognize_fast() call.
+	 * Does not touch the caller's frame, so no frame lock is needed.
+	 */
+	int verify(int *confidence = nullptr);
+
+	/**
+	 * Recognize several crops with one Tesseract pass. Crops that miss the
+	 * cache are contrast-normalized and stacked into a single image, and
+	 * each recognized text line is mapped back to its crop by bounding
+	 * box. Crops may come from different frames or sources.
+	 * @return One result per crop, in the same order
+	 */
+	std::vector<OcrResult>
+	recognize_batch(const std::vector<OcrCrop> &crops);
+
+	/** Results of earlier high-confidence recognitions, by crop hash */
+	OcrCache &cache() { return result_cache; }
+
+	/** Digit templates learned from confident recognitions */
+	DigitTemplates &digit_templates() { return templates; }
 
 private:
+	int run_tesseract(const uint8_t *gray, int width, int height,
+			  uint64_t crop_key, int *confidence);
+	void remember(const uint8_t *gray, int width, int height,
+		      uint64_t crop_key, int value, int confidence);
+
+	OcrCache result_cache;
+	DigitTemplates templates;
+
+	// Grayscale crop for recognize(), reused across calls
+	std::vector<uint8_t> gray_buffer;
+
+	// Crop kept by recognize_fast() for verify()
+	std::vector<uint8_t> fast_gray;
+	OcrRegion fast_region;
+	uint64_t fast_key;
+
 	void *tess_api; // tesseract::TessBaseAPI* (opaque to avoid header leak)
 	bool initialized;
 };
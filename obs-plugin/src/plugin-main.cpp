@@ -1,6 +1,7 @@
 #include <obs-module.h>
 #include "plugin-support.h"
 #include "sr-source.h"
+#include "trace.h"
 
 OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE(PLUGIN_NAME, "en-US")
@@ -14,6 +15,7 @@ bool obs_module_load(void)
 
 void obs_module_unload(void)
 {
+	sr_trace_shutdown();
 	sr_log_info("plugin unloaded");
 }
 
@@ -0,0 +1,746 @@
+#include "push-server.h"
+#include "plugin-support.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET socket_t;
+#define SR_BAD_SOCKET INVALID_SOCKET
+#define sr_poll WSAPoll
+#define sr_close_socket closesocket
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+typedef int socket_t;
+#define SR_BAD_SOCKET (-1)
+#define sr_poll poll
+#define sr_close_socket close
+#endif
+
+#ifdef MSG_NOSIGNAL
+#define SR_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SR_SEND_FLAGS 0
+#endif
+
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Limits that keep a misbehaving client from growing without bound
+#define MAX_CLIENTS 256
+#define MAX_REQUEST_BYTES 8192
+#define MAX_OUTBOUND_BYTES (1024 * 1024)
+#define MAX_WS_PAYLOAD 4096
+
+static const char *WS_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+struct PushClient {
+	socket_t sock = SR_BAD_SOCKET;
+	std::string in;
+	std::string out;
+	bool websocket = false;
+	bool close_after_flush = false;
+};
+
+/* ------------------------------------------------------------------ */
+/* Socket helpers                                                      */
+/* ------------------------------------------------------------------ */
+
+static socket_t to_sock(uintptr_t s)
+{
+	return (socket_t)s;
+}
+
+static uintptr_t from_sock(socket_t s)
+{
+	return (uintptr_t)s;
+}
+
+static bool would_block()
+{
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+static bool set_nonblocking(socket_t s)
+{
+#ifdef _WIN32
+	u_long mode = 1;
+	return ioctlsocket(s, FIONBIO, &mode) == 0;
+#else
+	int flags = fcntl(s, F_GETFL, 0);
+	return flags >= 0 && fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+static sockaddr_in loopback_addr(uint16_t port)
+{
+	sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+	return addr;
+}
+
+/* ------------------------------------------------------------------ */
+/* SHA-1 + base64 for the WebSocket handshake                          */
+/* ------------------------------------------------------------------ */
+
+static uint32_t rol32(uint32_t v, int bits)
+{
+	return (v << bits) | (v >> (32 - bits));
+}
+
+static void sha1(const std::string &msg, uint8_t digest[20])
+{
+	uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476,
+			 0xC3D2E1F0};
+
+	std::string data = msg;
+	uint64_t bit_len = (uint64_t)msg.size() * 8;
+	data += (char)0x80;
+	while (data.size() % 64 != 56)
+		data += (char)0x00;
+	for (int i = 7; i >= 0; i--)
+		data += (char)((bit_len >> (i * 8)) & 0xFF);
+
+	for (size_t chunk = 0; chunk < data.size(); chunk += 64) {
+		uint32_t w[80];
+		for (int i = 0; i < 16; i++) {
+			const auto *p = reinterpret_cast<const uint8_t *>(
+				data.data() + chunk + i * 4);
+			w[i] = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+			       ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+		}
+		for (int i = 16; i < 80; i++)
+			w[i] = rol32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^
+					     w[i - 16],
+				     1);
+
+		uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+		for (int i = 0; i < 80; i++) {
+			uint32_t f, k;
+			if (i < 20) {
+				f = (b & c) | (~b & d);
+				k = 0x5A827999;
+			} else if (i < 40) {
+				f = b ^ c ^ d;
+				k = 0x6ED9EBA1;
+			} else if (i < 60) {
+				f = (b & c) | (b & d) | (c & d);
+				k = 0x8F1BBCDC;
+			} else {
+				f = b ^ c ^ d;
+				k = 0xCA62C1D6;
+			}
+			uint32_t tmp = rol32(a, 5) + f + e + k + w[i];
+			e = d;
+			d = c;
+			c = rol32(b, 30);
+			b = a;
+			a = tmp;
+		}
+		h[0] += a;
+		h[1] += b;
+		h[2] += c;
+		h[3] += d;
+		h[4] += e;
+	}
+
+	for (int i = 0; i < 5; i++) {
+		digest[i * 4 + 0] = (uint8_t)(h[i] >> 24);
+		digest[i * 4 + 1] = (uint8_t)(h[i] >> 16);
+		digest[i * 4 + 2] = (uint8_t)(h[i] >> 8);
+		digest[i * 4 + 3] = (uint8_t)(h[i]);
+	}
+}
+
+static std::string base64_encode(const uint8_t *data, size_t len)
+{
+	static const char *table =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+	std::string out;
+	for (size_t i = 0; i < len; i += 3) {
+		uint32_t n = (uint32_t)data[i] << 16;
+		if (i + 1 < len)
+			n |= (uint32_t)data[i + 1] << 8;
+		if (i + 2 < len)
+			n |= (uint32_t)data[i + 2];
+
+		out += table[(n >> 18) & 63];
+		out += table[(n >> 12) & 63];
+		out += (i + 1 < len) ? table[(n >> 6) & 63] : '=';
+		out += (i + 2 < len) ? table[n & 63] : '=';
+	}
+	return out;
+}
+
+/* Case-insensitive lookup of an HTTP header value in a raw request */
+static std::string find_header(const std::string &request, const char *name)
+{
+	size_t name_len = std::strlen(name);
+	size_t pos = request.find("\r\n");
+
+	while (pos != std::string::npos) {
+		size_t line_start = pos + 2;
+		size_t line_end = request.find("\r\n", line_start);
+		if (line_end == std::string::npos || line_end == line_start)
+			break;
+
+		size_t colon = request.find(':', line_start);
+		if (colon != std::string::npos && colon < line_end &&
+		    colon - line_start == name_len) {
+			bool match = true;
+			for (size_t i = 0; i < name_len && match; i++) {
+				auto a = (unsigned char)request[line_start + i];
+				auto b = (unsigned char)name[i];
+				match = std::tolower(a) == std::tolower(b);
+			}
+			if (match) {
+				size_t v = colon + 1;
+				while (v < line_end && request[v] == ' ')
+					v++;
+				return request.substr(v, line_end - v);
+			}
+		}
+		pos = line_end;
+	}
+	return "";
+}
+
+/* Whether a comma-separated header value lists token, ignoring case */
+static bool has_token(const std::string &value, const char *token)
+{
+	size_t token_len = std::strlen(token);
+	size_t pos = 0;
+
+	while (pos < value.size()) {
+		size_t end = value.find(',', pos);
+		if (end == std::string::npos)
+			end = value.size();
+
+		size_t first = value.find_first_not_of(" \t", pos);
+		size_t last = value.find_last_not_of(" \t", end - 1);
+		bool match = first != std::string::npos && first < end &&
+			     last - first + 1 == token_len;
+		for (size_t i = 0; i < token_len && match; i++) {
+			auto a = (unsigned char)value[first + i];
+			auto b = (unsigned char)token[i];
+			match = std::tolower(a) == std::tolower(b);
+		}
+		if (match)
+			return true;
+		pos = end + 1;
+	}
+	return false;
+}
+
+/* Lowercase without a trailing slash, the form origins are compared in */
+static std::string normalize_origin(std::string origin)
+{
+	for (char &c : origin)
+		c = (char)std::tolower((unsigned char)c);
+	while (!origin.empty() && origin.back() == '/')
+		origin.pop_back();
+	return origin;
+}
+
+static void append_response(std::string &out, const char *status,
+			    const std::string &body, const std::string &cors)
+{
+	out += status;
+	out += "Content-Type: application/json\r\n";
+	if (!cors.empty()) {
+		out += "Access-Control-Allow-Origin: ";
+		out += cors;
+		out += "\r\n";
+	}
+	out += "Vary: Origin\r\n"
+	       "Cache-Control: no-store\r\n"
+	       "Connection: close\r\n"
+	       "Content-Length: ";
+	out += std::to_string(body.size());
+	out += "\r\n\r\n";
+	out += body;
+}
+
+/* ------------------------------------------------------------------ */
+/* PushServer                                                          */
+/* ------------------------------------------------------------------ */
+
+PushServer::PushServer()
+	: listen_sock(from_sock(SR_BAD_SOCKET)),
+	  wake_recv(from_sock(SR_BAD_SOCKET)),
+	  wake_send(from_sock(SR_BAD_SOCKET)),
+	  listen_port(0),
+	  snapshot("{\"type\":\"sr\",\"sr\":null}"),
+	  running(false),
+	  num_clients(0)
+{
+}
+
+PushServer::~PushServer()
+{
+	stop();
+}
+
+bool PushServer::start(uint16_t port)
+{
+	if (running.load())
+		stop();
+
+#ifdef _WIN32
+	WSADATA wsa;
+	if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+		sr_log_error("Push server: WSAStartup failed");
+		return false;
+	}
+#endif
+
+	socket_t ls = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	socket_t wr = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	socket_t ws = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+	auto fail = [&](const char *what) {
+		sr_log_error("Push server: %s failed (port %u)", what,
+			     (unsigned)port);
+		if (ls != SR_BAD_SOCKET)
+			sr_close_socket(ls);
+		if (wr != SR_BAD_SOCKET)
+			sr_close_socket(wr);
+		if (ws != SR_BAD_SOCKET)
+			sr_close_socket(ws);
+#ifdef _WIN32
+		WSACleanup();
+#endif
+		return false;
+	};
+
+	if (ls == SR_BAD_SOCKET || wr == SR_BAD_SOCKET || ws == SR_BAD_SOCKET)
+		return fail("socket");
+
+#ifndef _WIN32
+	int reuse = 1;
+	setsockopt(ls, SOL_SOCKET, SO_REUSEADDR, (const char *)&reuse,
+		   sizeof(reuse));
+#endif
+
+	// Only ever listen on loopback — overlays run on the same machine
+	sockaddr_in addr = loopback_addr(port);
+	if (bind(ls, (sockaddr *)&addr, sizeof(addr)) != 0)
+		return fail("bind");
+	if (listen(ls, 16) != 0)
+		return fail("listen");
+	if (!set_nonblocking(ls))
+		return fail("set_nonblocking");
+
+	// Wakeup channel: a connected loopback UDP pair works with poll() on
+	// every platform, unlike pipes on Windows
+	sockaddr_in wake_addr = loopback_addr(0);
+	socklen_t wake_len = sizeof(wake_addr);
+	if (bind(wr, (sockaddr *)&wake_addr, sizeof(wake_addr)) != 0 ||
+	    getsockname(wr, (sockaddr *)&wake_addr, &wake_len) != 0 ||
+	    connect(ws, (sockaddr *)&wake_addr, sizeof(wake_addr)) != 0)
+		return fail("wakeup socket");
+	set_nonblocking(wr);
+	set_nonblocking(ws);
+
+	listen_sock = from_sock(ls);
+	wake_recv = from_sock(wr);
+	wake_send = from_sock(ws);
+	listen_port = port;
+
+	running.store(true);
+	loop_thread = std::thread(&PushServer::run_loop, this);
+
+	sr_log_info("Push server listening on 127.0.0.1:%u", (unsigned)port);
+	return true;
+}
+
+void PushServer::stop()
+{
+	if (!running.exchange(false))
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(pending_mutex);
+		char b = 0;
+		send(to_sock(wake_send), &b, 1, 0);
+	}
+	if (loop_thread.joinable())
+		loop_thread.join();
+
+	for (auto &client : clients)
+		sr_close_socket(client->sock);
+	clients.clear();
+	num_clients.store(0);
+
+	{
+		std::lock_guard<std::mutex> lock(pending_mutex);
+		sr_close_socket(to_sock(wake_send));
+		wake_send = from_sock(SR_BAD_SOCKET);
+		pending.clear();
+	}
+
+	sr_close_socket(to_sock(listen_sock));
+	sr_close_socket(to_sock(wake_recv));
+	listen_sock = wake_recv = from_sock(SR_BAD_SOCKET);
+
+#ifdef _WIN32
+	WSACleanup();
+#endif
+
+	sr_log_info("Push server stopped");
+}
+
+void PushServer::publish(const std::string &json, bool retain)
+{
+	if (!running.load())
+		return;
+
+	std::lock_guard<std::mutex> lock(pending_mutex);
+	if (retain)
+		snapshot = json;
+
+	// Nobody listening — keep the snapshot but skip the fan-out
+	if (num_clients.load() == 0 || wake_send == from_sock(SR_BAD_SOCKET))
+		return;
+	pending.push_back(json);
+
+	// Non-blocking: if the datagram queue is full a wakeup is already
+	// pending, so a dropped byte loses nothing
+	char b = 1;
+	send(to_sock(wake_send), &b, 1, 0);
+}
+
+void PushServer::set_allowed_origins(const std::string &list)
+{
+	std::vector<std::string> origins;
+	size_t pos = 0;
+	while (pos < list.size()) {
+		size_t end = list.find_first_of(", \t\r\n", pos);
+		if (end == std::string::npos)
+			end = list.size();
+		if (end > pos)
+			origins.push_back(
+				normalize_origin(list.substr(pos, end - pos)));
+		pos = end + 1;
+	}
+
+	std::lock_guard<std::mutex> lock(pending_mutex);
+	allowed_origins = std::move(origins);
+}
+
+void PushServer::drain_wakeup()
+{
+	char buf[64];
+	while (recv(to_sock(wake_recv), buf, sizeof(buf), 0) > 0) {
+	}
+}
+
+void PushServer::accept_clients()
+{
+	for (;;) {
+		socket_t s = accept(to_sock(listen_sock), nullptr, nullptr);
+		if (s == SR_BAD_SOCKET)
+			return;
+
+		if (clients.size() >= MAX_CLIENTS || !set_nonblocking(s)) {
+			sr_close_socket(s);
+			continue;
+		}
+
+		int nodelay = 1;
+		setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char *)&nodelay,
+			   sizeof(nodelay));
+
+		auto client = std::make_unique<PushClient>();
+		client->sock = s;
+		clients.push_back(std::move(client));
+	}
+}
+
+bool PushServer::read_client(PushClient &client)
+{
+	char buf[2048];
+
+	for (;;) {
+		int n = (int)recv(client.sock, buf, sizeof(buf), 0);
+		if (n == 0)
+			return false;
+		if (n < 0)
+			return would_block();
+
+		client.in.append(buf, (size_t)n);
+
+		if (client.websocket) {
+			if (!handle_ws_frames(client))
+				return false;
+		} else {
+			if (client.in.size() > MAX_REQUEST_BYTES)
+				return false;
+			if (client.in.find("\r\n\r\n") != std::string::npos)
+				handle_http(client);
+		}
+	}
+}
+
+bool PushServer::write_client(PushClient &client)
+{
+	while (!client.out.empty()) {
+		int n = (int)send(client.sock, client.out.data(),
+				  (int)client.out.size(), SR_SEND_FLAGS);
+		if (n < 0)
+			return would_block();
+		client.out.erase(0, (size_t)n);
+	}
+
+	return !client.close_after_flush;
+}
+
+void PushServer::handle_http(PushClient &client)
+{
+	std::string request = client.in;
+	client.in.clear();
+
+	std::string origin = find_header(request, "Origin");
+	std::string current;
+	bool listed;
+	{
+		std::lock_guard<std::mutex> lock(pending_mutex);
+		current = snapshot;
+		listed = std::find(allowed_origins.begin(),
+				   allowed_origins.end(),
+				   normalize_origin(origin)) !=
+			 allowed_origins.end();
+	}
+
+	std::string key = find_header(request, "Sec-WebSocket-Key");
+	bool upgrade =
+		has_token(find_header(request, "Upgrade"), "websocket") &&
+		has_token(find_header(request, "Connection"), "upgrade");
+	if (upgrade || !key.empty()) {
+		// Browsers always send Origin on an upgrade; OBS sends none,
+		// or "null" for a browser source showing a local file
+		if (!upgrade || key.empty()) {
+			append_response(client.out,
+					"HTTP/1.1 400 Bad Request\r\n",
+					"{\"error\":\"bad upgrade\"}", "");
+			client.close_after_flush = true;
+			return;
+		}
+		if (!origin.empty() && origin != "null" && !listed) {
+			sr_log_warn("Push server: refused subscriber from %s",
+				    origin.c_str());
+			append_response(client.out,
+					"HTTP/1.1 403 Forbidden\r\n",
+					"{\"error\":\"origin\"}", "");
+			client.close_after_flush = true;
+			return;
+		}
+
+		uint8_t digest[20];
+		sha1(key + WS_GUID, digest);
+
+		client.out += "HTTP/1.1 101 Switching Protocols\r\n"
+			      "Upgrade: websocket\r\n"
+			      "Connection: Upgrade\r\n"
+			      "Sec-WebSocket-Accept: ";
+		client.out += base64_encode(digest, sizeof(digest));
+		client.out += "\r\n\r\n";
+		client.websocket = true;
+		num_clients.fetch_add(1);
+
+		// New subscribers get the current value straight away
+		queue_frame(client, 0x1, current);
+		return;
+	}
+
+	// Only GET /sr is served; the query string, if any, is ignored
+	const char *status = "HTTP/1.1 200 OK\r\n";
+	std::string body = current;
+	if (request.compare(0, 4, "GET ") != 0) {
+		status = "HTTP/1.1 405 Method Not Allowed\r\n";
+		body = "{\"error\":\"method\"}";
+	} else {
+		size_t end = request.find_first_of(" ?\r\n", 4);
+		if (request.compare(4, end - 4, "/sr") != 0) {
+			status = "HTTP/1.1 404 Not Found\r\n";
+			body = "{\"error\":\"not found\"}";
+		}
+	}
+
+	// Other pages may send the request, but their browser only lets
+	// them read the answer if it names their origin
+	append_response(client.out, status, body, listed ? origin : "");
+	client.close_after_flush = true;
+}
+
+bool PushServer::handle_ws_frames(PushClient &client)
+{
+	std::string &in = client.in;
+
+	while (in.size() >= 2) {
+		auto *p = reinterpret_cast<const uint8_t *>(in.data());
+		uint8_t opcode = p[0] & 0x0F;
+		bool masked = (p[1] & 0x80) != 0;
+		uint64_t len = p[1] & 0x7F;
+		size_t header = 2;
+
+		if (len == 126) {
+			if (in.size() < 4)
+				return true;
+			len = ((uint64_t)p[2] << 8) | p[3];
+			header = 4;
+		} else if (len == 127) {
+			if (in.size() < 10)
+				return true;
+			len = 0;
+			for (int i = 0; i < 8; i++)
+				len = (len << 8) | p[2 + i];
+			header = 10;
+		}
+
+		// Clients only ever send control frames; anything large is junk
+		if (len > MAX_WS_PAYLOAD)
+			return false;
+
+		size_t mask_at = header;
+		if (masked)
+			header += 4;
+		if (in.size() < header + len)
+			return true;
+
+		std::string payload = in.substr(header, (size_t)len);
+		if (masked) {
+			for (size_t i = 0; i < payload.size(); i++)
+				payload[i] ^= in[mask_at + (i % 4)];
+		}
+		in.erase(0, header + (size_t)len);
+
+		if (opcode == 0x8) {
+			queue_frame(client, 0x8, "");
+			client.close_after_flush = true;
+			return true;
+		}
+		if (opcode == 0x9)
+			queue_frame(client, 0xA, payload);
+	}
+
+	return true;
+}
+
+void PushServer::queue_frame(PushClient &client, uint8_t opcode,
+			     const std::string &payload)
+{
+	std::string &out = client.out;
+	size_t len = payload.size();
+
+	out += (char)(0x80 | opcode);
+	if (len < 126) {
+		out += (char)len;
+	} else if (len <= 0xFFFF) {
+		out += (char)126;
+		out += (char)((len >> 8) & 0xFF);
+		out += (char)(len & 0xFF);
+	} else {
+		out += (char)127;
+		for (int i = 7; i >= 0; i--)
+			out += (char)(((uint64_t)len >> (i * 8)) & 0xFF);
+	}
+	out += payload;
+}
+
+void PushServer::run_loop()
+{
+	std::vector<pollfd> fds;
+	std::vector<std::string> batch;
+
+	while (running.load()) {
+		fds.clear();
+		fds.push_back({to_sock(listen_sock), POLLIN, 0});
+		fds.push_back({to_sock(wake_recv), POLLIN, 0});
+		for (auto &client : clients) {
+			short events = POLLIN;
+			if (!client->out.empty())
+				events |= POLLOUT;
+			fds.push_back({client->sock, events, 0});
+		}
+
+		int ready =
+			sr_poll(fds.data(), (unsigned long)fds.size(), 1000);
+		if (!running.load())
+			break;
+		if (ready < 0)
+			continue;
+
+		if (fds[1].revents & POLLIN)
+			drain_wakeup();
+
+		// Fan out everything published since the last pass
+		{
+			std::lock_guard<std::mutex> lock(pending_mutex);
+			batch.swap(pending);
+		}
+		for (auto &msg : batch) {
+			for (auto &client : clients) {
+				if (client->websocket &&
+				    !client->close_after_flush)
+					queue_frame(*client, 0x1, msg);
+			}
+		}
+		batch.clear();
+
+		// Service existing clients; fds[2..] line up with clients
+		for (size_t i = 0; i < clients.size(); i++) {
+			PushClient &client = *clients[i];
+			short revents = fds[i + 2].revents;
+			bool keep = true;
+
+			if (revents & (POLLERR | POLLHUP | POLLNVAL))
+				keep = false;
+			if (keep && (revents & POLLIN))
+				keep = read_client(client);
+			if (keep && client.out.size() > MAX_OUTBOUND_BYTES) {
+				sr_log_warn(
+					"Push server: dropping slow client");
+				keep = false;
+			}
+			if (keep && !client.out.empty())
+				keep = write_client(client);
+			if (keep && client.close_after_flush &&
+			    client.out.empty())
+				keep = false;
+
+			if (!keep) {
+				if (client.websocket)
+					num_clients.fetch_sub(1);
+				sr_close_socket(client.sock);
+				clients[i].reset();
+			}
+		}
+
+		clients.erase(std::remove(clients.begin(), clients.end(),
+					  nullptr),
+			      clients.end());
+
+		if (fds[0].revents & POLLIN)
+			accept_clients();
+	}
+}
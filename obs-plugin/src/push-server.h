@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+
+struct PushClient;
+
+/**
+ * Minimal localhost HTTP/WebSocket server for browser-source overlays.
+ *
+ * A single event-loop thread owns every socket. Producers hand messages over
+ * with publish(), which only appends to a pending list and pokes a wakeup
+ * socket, so the OCR worker never waits on a slow or stalled client.
+ *
+ * Clients either upgrade to a WebSocket on any path and receive every
+ * published message, or issue a plain GET /sr and receive the latest retained
+ * SR snapshot as JSON. Any other plain HTTP path gets a 404.
+ *
+ * Any page open in the streamer's browser can reach 127.0.0.1, so browsers
+ * are told apart by their Origin header: upgrades are accepted without one,
+ * with "null" (OBS browser sources on local files) or from an allowed
+ * origin, and only allowed origins may read GET /sr across origins.
+ */
+class PushServer {
+public:
+	PushServer();
+	~PushServer();
+
+	PushServer(const PushServer &) = delete;
+	PushServer &operator=(const PushServer &) = delete;
+
+	bool start(uint16_t port);
+	void stop();
+	bool is_running() const { return running.load(); }
+	uint16_t port() const { return listen_port; }
+
+	/**
+	 * Queue a JSON message for all WebSocket subscribers.
+	 * @param json    Complete JSON text to send as one text frame
+	 * @param retain  Keep as the snapshot sent to new subscribers and
+	 *                returned by GET /sr
+	 */
+	void publish(const std::string &json, bool retain);
+
+	/**
+	 * Set the page origins, besides OBS's own, that may subscribe and
+	 * read GET /sr, e.g. "http://localhost:3000". Comma or space
+	 * separated; case and a trailing slash are ignored.
+	 */
+	void set_allowed_origins(const std::string &list);
+
+	size_t client_count() const { return num_clients.load(); }
+
+private:
+	void run_loop();
+	void accept_clients();
+	bool read_client(PushClient &client);
+	bool write_client(PushClient &client);
+	void handle_http(PushClient &client);
+	bool handle_ws_frames(PushClient &client);
+	void queue_frame(PushClient &client, uint8_t opcode,
+			 const std::string &payload);
+	void drain_wakeup();
+
+	uintptr_t listen_sock;
+	uintptr_t wake_recv;
+	uintptr_t wake_send;
+	uint16_t listen_port;
+
+	std::vector<std::unique_ptr<PushClient>> clients;
+
+	// Handoff from publishers to the loop thread
+	std::mutex pending_mutex;
+	std::vector<std::string> pending;
+	std::string snapshot;
+	std::vector<std::string> allowed_origins;
+
+	std::thread loop_thread;
+	std::atomic<bool> running;
+	std::atomic<size_t> num_clients;
+};
@@ -0,0 +1,163 @@
+#include "screen-gate.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+// Mean per-channel difference (0-255) still counted as the same screen
+#define MATCH_THRESHOLD 24
+// A learned frame this close to a reference refreshes it instead of adding
+#define REFRESH_THRESHOLD 8
+// Let one gated frame through to OCR after this many in a row
+#define PROBE_EVERY 10
+// Pixels sampled per cell along each axis
+#define CELL_SAMPLES 4
+
+ScreenGate::ScreenGate()
+{
+	reset();
+}
+
+void ScreenGate::reset()
+{
+	ref_count = 0;
+	ref_next = 0;
+	ref_region = {0, 0, 0, 0};
+	last_valid = false;
+	gated_run = 0;
+	checked = 0;
+	gated = 0;
+}
+
+ScreenGateStats ScreenGate::stats() const
+{
+	return {checked.load(), gated.load(), ref_count.load()};
+}
+
+/*
+ * Mean color of each cell in a grid spanning the region grown by one region
+ * height on every side (clamped to the frame). Cells whose center falls in
+ * the region hold the changing digits and are not compared.
+ */
+bool ScreenGate::compute(const uint8_t *bgra_data, int linesize, int width,
+			 int height, const OcrRegion &region, Signature &out)
+{
+	int margin = region.height;
+	int x0 = std::max(0, region.x - margin);
+	int y0 = std::max(0, region.y - margin);
+	int x1 = std::min(width, region.x + region.width + margin);
+	int y1 = std::min(height, region.y + region.height + margin);
+	if (x1 - x0 < SCREEN_GATE_GRID_W || y1 - y0 < SCREEN_GATE_GRID_H)
+		return false;
+
+	bool any = false;
+	for (int gy = 0; gy < SCREEN_GATE_GRID_H; gy++) {
+		int cy0 = y0 + gy * (y1 - y0) / SCREEN_GATE_GRID_H;
+		int cy1 = y0 + (gy + 1) * (y1 - y0) / SCREEN_GATE_GRID_H;
+
+		for (int gx = 0; gx < SCREEN_GATE_GRID_W; gx++) {
+			int cx0 = x0 + gx * (x1 - x0) / SCREEN_GATE_GRID_W;
+			int cx1 = x0 + (gx + 1) * (x1 - x0) / SCREEN_GATE_GRID_W;
+			int cell = gy * SCREEN_GATE_GRID_W + gx;
+
+			int cx = (cx0 + cx1) / 2;
+			int cy = (cy0 + cy1) / 2;
+			out.used[cell] = !(cx >= region.x &&
+					   cx < region.x + region.width &&
+					   cy >= region.y &&
+					   cy < region.y + region.height);
+			if (!out.used[cell])
+				continue;
+
+			int sum[3] = {0, 0, 0};
+			for (int sy = 0; sy < CELL_SAMPLES; sy++) {
+				int y = cy0 + (2 * sy + 1) * (cy1 - cy0) /
+						      (2 * CELL_SAMPLES);
+				const uint8_t *row = bgra_data + y * linesize;
+
+				for (int sx = 0; sx < CELL_SAMPLES; sx++) {
+					int x = cx0 + (2 * sx + 1) * (cx1 - cx0) /
+							      (2 * CELL_SAMPLES);
+					sum[0] += row[x * 4 + 0];
+					sum[1] += row[x * 4 + 1];
+					sum[2] += row[x * 4 + 2];
+				}
+			}
+
+			const int n = CELL_SAMPLES * CELL_SAMPLES;
+			for (int c = 0; c < 3; c++)
+				out.bgr[cell][c] = (uint8_t)(sum[c] / n);
+			any = true;
+		}
+	}
+
+	return any;
+}
+
+int ScreenGate::distance(const Signature &a, const Signature &b) const
+{
+	int total = 0;
+	int count = 0;
+	for (int i = 0; i < SCREEN_GATE_CELLS; i++) {
+		if (!a.used[i] || !b.used[i])
+			continue;
+		for (int c = 0; c < 3; c++)
+			total += std::abs((int)a.bgr[i][c] - (int)b.bgr[i][c]);
+		count += 3;
+	}
+	return count ? total / count : 255;
+}
+
+bool ScreenGate::check(const uint8_t *bgra_data, int linesize, int width,
+		       int height, const OcrRegion &region)
+{
+	checked++;
+
+	// Screens learned for another region say nothing about this one
+	if (region.x != ref_region.x || region.y != ref_region.y ||
+	    region.width != ref_region.width ||
+	    region.height != ref_region.height) {
+		ref_count = 0;
+		ref_next = 0;
+		ref_region = region;
+	}
+
+	last_valid =
+		compute(bgra_data, linesize, width, height, region, last);
+	if (!last_valid || ref_count == 0)
+		return true;
+
+	for (int i = 0; i < ref_count; i++) {
+		if (distance(last, refs[i]) <= MATCH_THRESHOLD) {
+			gated_run = 0;
+			return true;
+		}
+	}
+
+	if (++gated_run >= PROBE_EVERY) {
+		gated_run = 0;
+		return true;
+	}
+
+	gated++;
+	return false;
+}
+
+void ScreenGate::learn()
+{
+	if (!last_valid)
+		return;
+
+	int count = ref_count;
+	for (int i = 0; i < count; i++) {
+		if (distance(last, refs[i]) <= REFRESH_THRESHOLD) {
+			refs[i] = last;
+			return;
+		}
+	}
+
+	refs[ref_next] = last;
+	ref_next = (ref_next + 1) % SCREEN_GATE_REFERENCES;
+	if (count < SCREEN_GATE_REFERENCES)
+		ref_count = count + 1;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "ocr-engine.h"
+
+// Signature grid laid over the SR region plus a margin on every side
+#define SCREEN_GATE_GRID_W 16
+#define SCREEN_GATE_GRID_H 8
+#define SCREEN_GATE_CELLS (SCREEN_GATE_GRID_W * SCREEN_GATE_GRID_H)
+// Distinct SR screens remembered (lobby, post-match, ...)
+#define SCREEN_GATE_REFERENCES 4
+
+struct ScreenGateStats {
+	uint64_t checked;
+	uint64_t gated;
+	int references;
+};
+
+/**
+ * Decides from a few hundred sampled pixels whether the screen that shows
+ * the SR is visible, so gameplay frames can skip OCR.
+ *
+ * The signature is the mean color of each grid cell around the SR region;
+ * cells covering the digits themselves are left out. Screens are learned
+ * from frames that produced a confident SR read, so until the first such
+ * read nothing is gated. Every few gated frames one is let through anyway
+ * to pick up screens the gate has not seen yet. check() and learn() belong
+ * to one thread; stats() may be called from any.
+ */
+class ScreenGate {
+public:
+	ScreenGate();
+
+	/** @return true if OCR should run on this frame */
+	bool check(const uint8_t *bgra_data, int linesize, int width,
+		   int height, const OcrRegion &region);
+
+	/** The last checked frame gave a confident read: remember it */
+	void learn();
+
+	void reset();
+	ScreenGateStats stats() const;
+
+private:
+	struct Signature {
+		uint8_t bgr[SCREEN_GATE_CELLS][3];
+		bool used[SCREEN_GATE_CELLS];
+	};
+
+	bool compute(const uint8_t *bgra_data, int linesize, int width,
+		     int height, const OcrRegion &region, Signature &out);
+	int distance(const Signature &a, const Signature &b) const;
+
+	Signature refs[SCREEN_GATE_REFERENCES];
+	std::atomic<int> ref_count;
+	int ref_next;
+	OcrRegion ref_region;
+
+	Signature last;
+	bool last_valid;
+	int gated_run;
+
+	std::atomic<uint64_t> checked;
+	std::atomic<uint64_t> gated;
+};
@@ -0,0 +1,268 @@
+#include "sr-history.h"
+#include "plugin-support.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+
+#define SR_HISTORY_MAGIC "SRH1"
+#define SR_HISTORY_VERSION 1
+
+// On-disk layout: this header followed directly by the sample ring
+struct SrHistoryHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t capacity;
+	uint32_t sample_size;
+	uint64_t count; // total samples ever written; slot = count % capacity
+	int32_t peak;
+	int32_t reserved;
+};
+
+static_assert(sizeof(SrHistoryHeader) % alignof(SrSample) == 0,
+	      "samples must stay aligned after the header");
+
+static const size_t HISTORY_BYTES =
+	sizeof(SrHistoryHeader) + sizeof(SrSample) * SR_HISTORY_CAPACITY;
+
+SrHistory::SrHistory()
+	: header(nullptr),
+	  samples(nullptr),
+	  map_base(nullptr),
+	  map_size(0),
+	  file_handle(-1),
+	  mapping_handle(-1),
+	  agg(),
+	  rolling_sum(0)
+{
+}
+
+SrHistory::~SrHistory()
+{
+	close();
+}
+
+bool SrHistory::open(const std::string &path)
+{
+	close();
+
+	std::lock_guard<std::mutex> lock(history_mutex);
+	bool reset = false;
+
+#ifdef _WIN32
+	int wlen = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr,
+				       0);
+	std::wstring wpath(wlen > 0 ? wlen - 1 : 0, L'\0');
+	if (wlen > 0)
+		MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wpath[0],
+				    wlen);
+
+	HANDLE file = CreateFileW(wpath.c_str(), GENERIC_READ | GENERIC_WRITE,
+				  FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+				  FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file != INVALID_HANDLE_VALUE) {
+		LARGE_INTEGER size = {};
+		GetFileSizeEx(file, &size);
+		reset = (uint64_t)size.QuadPart != HISTORY_BYTES;
+
+		// Mapping past the end grows the file with zeroes
+		HANDLE mapping = CreateFileMappingW(file, nullptr,
+						    PAGE_READWRITE, 0,
+						    (DWORD)HISTORY_BYTES,
+						    nullptr);
+		void *base = mapping ? MapViewOfFile(mapping,
+						     FILE_MAP_ALL_ACCESS, 0, 0,
+						     HISTORY_BYTES)
+				     : nullptr;
+		if (base) {
+			file_handle = (intptr_t)file;
+			mapping_handle = (intptr_t)mapping;
+			map_base = base;
+			map_size = HISTORY_BYTES;
+		} else {
+			if (mapping)
+				CloseHandle(mapping);
+			CloseHandle(file);
+		}
+	}
+#else
+	int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+	if (fd >= 0) {
+		struct stat st = {};
+		fstat(fd, &st);
+		reset = (uint64_t)st.st_size != HISTORY_BYTES;
+
+		void *base = MAP_FAILED;
+		if (!reset || ftruncate(fd, (off_t)HISTORY_BYTES) == 0)
+			base = mmap(nullptr, HISTORY_BYTES,
+				    PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (base != MAP_FAILED) {
+			file_handle = fd;
+			map_base = base;
+			map_size = HISTORY_BYTES;
+		} else {
+			::close(fd);
+		}
+	}
+#endif
+
+	if (map_base) {
+		attach(map_base, reset);
+		sr_log_info("SR history mapped: %s (%zu samples)", path.c_str(),
+			    (size_t)std::min<uint64_t>(header->count,
+						       SR_HISTORY_CAPACITY));
+		return true;
+	}
+
+	// Keep working for this session even if the file can't be mapped
+	sr_log_warn("SR history: could not map %s, history won't persist",
+		    path.c_str());
+	fallback.assign(HISTORY_BYTES, 0);
+	attach(fallback.data(), true);
+	return false;
+}
+
+void SrHistory::close()
+{
+	std::lock_guard<std::mutex> lock(history_mutex);
+
+	if (map_base) {
+#ifdef _WIN32
+		FlushViewOfFile(map_base, map_size);
+		UnmapViewOfFile(map_base);
+		CloseHandle((HANDLE)mapping_handle);
+		CloseHandle((HANDLE)file_handle);
+#else
+		msync(map_base, map_size, MS_ASYNC);
+		munmap(map_base, map_size);
+		::close((int)file_handle);
+#endif
+	}
+
+	map_base = nullptr;
+	map_size = 0;
+	file_handle = -1;
+	mapping_handle = -1;
+	fallback.clear();
+	header = nullptr;
+	samples = nullptr;
+}
+
+void SrHistory::attach(void *base, bool reset)
+{
+	header = static_cast<SrHistoryHeader *>(base);
+	samples = reinterpret_cast<SrSample *>(header + 1);
+
+	bool valid = !reset &&
+		     std::memcmp(header->magic, SR_HISTORY_MAGIC, 4) == 0 &&
+		     header->version == SR_HISTORY_VERSION &&
+		     header->capacity == SR_HISTORY_CAPACITY &&
+		     header->sample_size == sizeof(SrSample);
+
+	if (!valid) {
+		std::memset(base, 0, HISTORY_BYTES);
+		std::memcpy(header->magic, SR_HISTORY_MAGIC, 4);
+		header->version = SR_HISTORY_VERSION;
+		header->capacity = SR_HISTORY_CAPACITY;
+		header->sample_size = sizeof(SrSample);
+		header->peak = -1;
+	}
+
+	// Rebuild the rolling window once; record() keeps it current after
+	size_t n = (size_t)std::min<uint64_t>(header->count,
+					      SR_HISTORY_ROLLING_WINDOW);
+	rolling_sum = 0;
+	for (size_t i = 0; i < n; i++)
+		rolling_sum += sample_locked(i).sr;
+
+	agg = SrAggregates();
+	agg.current = header->count ? sample_locked(0).sr : -1;
+	agg.peak = header->peak;
+	agg.rolling_avg = n ? (double)rolling_sum / (double)n : 0.0;
+	agg.session_start = agg.session_min = agg.session_max = agg.current;
+}
+
+const SrSample &SrHistory::sample_locked(size_t age) const
+{
+	uint64_t idx = (header->count - 1 - age) % SR_HISTORY_CAPACITY;
+	return samples[idx];
+}
+
+void SrHistory::record(int sr, int confidence, int64_t timestamp)
+{
+	std::lock_guard<std::mutex> lock(history_mutex);
+	if (!header)
+		return;
+
+	// Drop the sample leaving the rolling window before overwriting
+	if (header->count >= SR_HISTORY_ROLLING_WINDOW)
+		rolling_sum -= sample_locked(SR_HISTORY_ROLLING_WINDOW - 1).sr;
+
+	SrSample &slot = samples[header->count % SR_HISTORY_CAPACITY];
+	slot.timestamp = timestamp;
+	slot.sr = sr;
+	slot.confidence = confidence;
+	header->count++;
+
+	if (sr > header->peak)
+		header->peak = sr;
+
+	rolling_sum += sr;
+	size_t window = (size_t)std::min<uint64_t>(header->count,
+						   SR_HISTORY_ROLLING_WINDOW);
+
+	if (agg.session_start < 0) {
+		agg.session_start = sr;
+		agg.session_min = sr;
+		agg.session_max = sr;
+	}
+	agg.current = sr;
+	agg.session_min = std::min(agg.session_min, sr);
+	agg.session_max = std::max(agg.session_max, sr);
+	agg.session_delta = sr - agg.session_start;
+	agg.session_samples++;
+	agg.peak = header->peak;
+	agg.rolling_avg = (double)rolling_sum / (double)window;
+}
+
+SrAggregates SrHistory::aggregates() const
+{
+	std::lock_guard<std::mutex> lock(history_mutex);
+	return agg;
+}
+
+size_t SrHistory::size() const
+{
+	std::lock_guard<std::mutex> lock(history_mutex);
+	if (!header)
+		return 0;
+	return (size_t)std::min<uint64_t>(header->count, SR_HISTORY_CAPACITY);
+}
+
+void SrHistory::snapshot(size_t max_samples, SrHistorySnapshot &out) const
+{
+	std::lock_guard<std::mutex> lock(history_mutex);
+	out.samples.clear();
+	out.aggregates = agg;
+	out.total_samples = header ? header->count : 0;
+	if (!header)
+		return;
+
+	size_t n = (size_t)std::min<uint64_t>(header->count,
+					      SR_HISTORY_CAPACITY);
+	n = std::min(n, max_samples);
+	out.samples.resize(n);
+	for (size_t i = 0; i < n; i++)
+		out.samples[i] = sample_locked(n - 1 - i);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+// Ring capacity in samples; one sample is recorded per SR change
+#define SR_HISTORY_CAPACITY 4096
+// Number of most recent samples covered by the rolling average
+#define SR_HISTORY_ROLLING_WINDOW 10
+
+struct SrSample {
+	int64_t timestamp;
+	int32_t sr;
+	int32_t confidence;
+};
+
+struct SrAggregates {
+	int current;
+	int session_start;
+	int session_delta;
+	int session_min;
+	int session_max;
+	int peak;
+	double rolling_avg;
+	uint64_t session_samples;
+};
+
+/** The newest samples and the aggregates, read under one lock */
+struct SrHistorySnapshot {
+	std::vector<SrSample> samples; // oldest first
+	SrAggregates aggregates;
+	uint64_t total_samples; // recorded since the file was created
+};
+
+struct SrHistoryHeader;
+
+/**
+ * Fixed-size ring of SR samples backed by a memory-mapped file.
+ *
+ * The mapped file *is* the ring, so history written in one OBS session is
+ * visible in the next without parsing anything. Aggregates are maintained
+ * incrementally on every record() and cost O(1) to read.
+ */
+class SrHistory {
+public:
+	SrHistory();
+	~SrHistory();
+
+	SrHistory(const SrHistory &) = delete;
+	SrHistory &operator=(const SrHistory &) = delete;
+
+	/**
+	 * Map the history file at path, creating or resetting it if missing
+	 * or invalid. Falls back to an in-memory ring if mapping fails.
+	 */
+	bool open(const std::string &path);
+	void close();
+
+	void record(int sr, int confidence, int64_t timestamp);
+
+	SrAggregates aggregates() const;
+	size_t size() const;
+
+	/**
+	 * Copy the newest max_samples samples (fewer if the ring holds
+	 * fewer) for history views and graphs. Reuses out's storage.
+	 */
+	void snapshot(size_t max_samples, SrHistorySnapshot &out) const;
+
+private:
+	void attach(void *base, bool reset);
+	const SrSample &sample_locked(size_t age) const;
+
+	SrHistoryHeader *header;
+	SrSample *samples;
+
+	// Platform mapping handles
+	void *map_base;
+	size_t map_size;
+	intptr_t file_handle;
+	intptr_t mapping_handle;
+	std::vector<uint8_t> fallback;
+
+	// Incremental aggregates
+	SrAggregates agg;
+	int64_t rolling_sum;
+
+	mutable std::mutex history_mutex;
+};
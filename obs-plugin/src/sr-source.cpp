@@ -1,14 +1,22 @@
 #include "sr-source.h"
 #include "plugin-support.h"
+#include "trace.h"
 
 #include <obs-module.h>
 #include <graphics/graphics.h>
 #include <util/platform.h>
 
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
 #include <cstring>
+#include <ctime>
 #include <string>
 #include <sstream>
 
+// How long destroy lets in-flight API requests finish before aborting
+#define API_SHUTDOWN_GRACE_MS 500
+
 /* ------------------------------------------------------------------ */
 /* Forward declarations for obs_source_info callbacks                  */
 /* ------------------------------------------------------------------ */
@@ -24,16 +32,259 @@ static void sr_video_render(void *data, gs_effect_t *effect);
 static uint32_t sr_get_width(void *data);
 static uint32_t sr_get_height(void *data);
 
+/* ------------------------------------------------------------------ */
+/* Overlay text                                                        */
+/* ------------------------------------------------------------------ */
+
+static bool replace_all(std::string &text, const char *placeholder,
+			const char *value)
+{
+	bool found = false;
+	size_t len = std::strlen(placeholder);
+	size_t value_len = std::strlen(value);
+	size_t pos = text.find(placeholder);
+
+	while (pos != std::string::npos) {
+		text.replace(pos, len, value, value_len);
+		found = true;
+		pos = text.find(placeholder, pos + value_len);
+	}
+	return found;
+}
+
+/* Writes a NUL-terminated decimal into buf (at least 12 bytes) */
+static const char *format_int(char *buf, size_t size, int value)
+{
+	*std::to_chars(buf, buf + size - 1, value).ptr = '\0';
+	return buf;
+}
+
+/*
+ * Expand {sr} and the history placeholders in the display format into
+ * text. Reuses text's storage, so repeat calls don't allocate once it has
+ * grown to fit.
+ */
+static void format_display(SrSourceData *sd, int sr, bool provisional,
+			   std::string &text)
+{
+	SrAggregates agg = sd->history.aggregates();
+	text.assign(sd->display_format);
+	bool found = false;
+
+	char num[16];
+	char delta[16];
+	snprintf(delta, sizeof(delta), "%+d", agg.session_delta);
+	char avg[16];
+	snprintf(avg, sizeof(avg), "%.0f", agg.rolling_avg);
+
+	found |= replace_all(text, "{sr}", format_int(num, sizeof(num), sr));
+	found |= replace_all(text, "{delta}", delta);
+	found |= replace_all(text, "{start}",
+			     format_int(num, sizeof(num), agg.session_start));
+	found |= replace_all(text, "{min}",
+			     format_int(num, sizeof(num), agg.session_min));
+	found |= replace_all(text, "{max}",
+			     format_int(num, sizeof(num), agg.session_max));
+	found |= replace_all(text, "{peak}",
+			     format_int(num, sizeof(num), agg.peak));
+	found |= replace_all(text, "{avg}", avg);
+	found |= replace_all(text, "{pending}", provisional ? "*" : "");
+
+	if (!found) {
+		text.assign("SR: ");
+		text.append(format_int(num, sizeof(num), sr));
+	}
+}
+
+static void update_overlay_text(SrSourceData *sd, int sr,
+				bool provisional = false)
+{
+	if (!sd->text_source)
+		return;
+
+	// Called from the worker and the UI thread
+	std::lock_guard<std::mutex> lock(sd->overlay_mutex);
+	format_display(sd, sr, provisional, sd->overlay_text);
+
+	obs_data_set_string(sd->overlay_settings, "text",
+			    sd->overlay_text.c_str());
+	obs_source_update(sd->text_source, sd->overlay_settings);
+}
+
+/* Blank the overlay when a guess is retracted and no SR is known */
+static void clear_overlay_text(SrSourceData *sd)
+{
+	if (!sd->text_source)
+		return;
+
+	std::lock_guard<std::mutex> lock(sd->overlay_mutex);
+	sd->overlay_text.clear();
+	obs_data_set_string(sd->overlay_settings, "text", "");
+	obs_source_update(sd->text_source, sd->overlay_settings);
+}
+
+/* ------------------------------------------------------------------ */
+/* Push server messages                                                */
+/* ------------------------------------------------------------------ */
+
+static void push_sr_change(SrSourceData *sd, int prev, int sr,
+			   bool provisional = false)
+{
+	if (!sd->push.is_running())
+		return;
+
+	// Provisional values are not in the history yet
+	SrAggregates agg = sd->history.aggregates();
+	int delta = agg.session_start >= 0 ? sr - agg.session_start : 0;
+	int peak = std::max(agg.peak, sr);
+
+	char json[224];
+	snprintf(json, sizeof(json),
+		 "{\"type\":\"sr\",\"sr\":%d,\"previous\":%d,\"delta\":%d,"
+		 "\"peak\":%d,\"state\":\"%s\",\"timestamp\":%lld}",
+		 sr, prev, delta, peak,
+		 provisional ? "provisional" : "confirmed",
+		 (long long)std::time(nullptr));
+	sd->push.publish(json, true);
+}
+
+/* A provisional value turned out unreadable and there is no SR to restore */
+static void push_sr_retraction(SrSourceData *sd, int guess)
+{
+	if (!sd->push.is_running())
+		return;
+
+	char json[160];
+	snprintf(json, sizeof(json),
+		 "{\"type\":\"sr\",\"sr\":-1,\"previous\":-1,"
+		 "\"retracted\":%d,\"state\":\"retracted\","
+		 "\"timestamp\":%lld}",
+		 guess, (long long)std::time(nullptr));
+	sd->push.publish(json, true);
+}
+
+static void push_pipeline_stats(SrSourceData *sd, double ocr_ms)
+{
+	if (!sd->push_stats.load() || !sd->push.is_running())
+		return;
+
+	OcrCacheStats cache = sd->ocr.cache().stats();
+	ScreenGateStats gate = sd->gate.stats();
+
+	char json[256];
+	snprintf(json, sizeof(json),
+		 "{\"type\":\"stats\",\"captures\":%llu,\"failures\":%llu,"
+		 "\"gated\":%llu,\"ocr_ms\":%.2f,\"cache_hits\":%llu,"
+		 "\"cache_misses\":%llu}",
+		 (unsigned long long)sd->captures_processed,
+		 (unsigned long long)sd->ocr_failures,
+		 (unsigned long long)gate.gated, ocr_ms,
+		 (unsigned long long)cache.hits,
+		 (unsigned long long)cache.misses);
+	sd->push.publish(json, false);
+}
+
+/* ------------------------------------------------------------------ */
+/* Warm-start state                                                    */
+/* ------------------------------------------------------------------ */
+
+/* Snapshot what was learned when the SR or the digit templates change */
+static void save_warm_state(SrSourceData *sd, int sr, int confidence)
+{
+	const DigitTemplates &templates = sd->ocr.digit_templates();
+	if (sr == sd->warm_sr && templates.revision() == sd->warm_revision)
+		return;
+
+	WarmState state = {};
+	state.last_sr = sr;
+	state.last_confidence = confidence;
+	state.saved_at = (int64_t)std::time(nullptr);
+	state.region = sd->region;
+	state.templates = templates.data();
+	sd->warm_writer.schedule(state);
+
+	sd->warm_sr = sr;
+	sd->warm_revision = templates.revision();
+}
+
+static void restore_warm_state(SrSourceData *sd, const std::string &path)
+{
+	WarmState state;
+	if (!warm_state_load(path, state))
+		return;
+
+	// Templates are only trusted for the crop they were learned from. A
+	// region that moved or was resized points at other pixels, so the
+	// templates would match the wrong glyphs.
+	const OcrRegion &saved = state.region;
+	bool same_crop = saved.x == sd->region.x && saved.y == sd->region.y &&
+			 saved.width == sd->region.width &&
+			 saved.height == sd->region.height;
+	if (same_crop)
+		sd->ocr.digit_templates().assign(state.templates);
+	else
+		sr_log_info("Warm state: region changed from %dx%d at (%d,%d); "
+			    "digit templates not restored",
+			    saved.width, saved.height, saved.x, saved.y);
+
+	// The history file normally has the last SR; this covers a reset one
+	if (sd->current_sr.load() < 0 && state.last_sr >= 0) {
+		sd->current_sr.store(state.last_sr);
+		update_overlay_text(sd, state.last_sr);
+	}
+
+	sd->warm_sr = state.last_sr;
+	sd->warm_revision = sd->ocr.digit_templates().revision();
+
+	// Every mode keeps learning templates, but only speculative
+	// recognition reads with them; say so rather than imply a faster start
+	const char *restored = "";
+	if (same_crop)
+		restored = sd->speculative.load()
+				   ? " and digit templates"
+				   : " and digit templates (unused until "
+				     "speculative recognition is on)";
+	sr_log_info("Warm state: restored SR %d%s from %s", state.last_sr,
+		    restored, path.c_str());
+}
+
 /* ------------------------------------------------------------------ */
 /* Worker thread                                                       */
 /* ------------------------------------------------------------------ */
 
+/* Fan an SR value out to history, push subscribers, overlay and API */
+static void publish_sr(SrSourceData *sd, int prev, int sr, int confidence,
+		       bool provisional)
+{
+	sd->current_sr.store(sr);
+
+	// History only keeps confirmed values
+	if (!provisional && sd->history.aggregates().current != sr)
+		sd->history.record(sr, confidence, (int64_t)std::time(nullptr));
+
+	// Push to browser-source overlays before the slower API call
+	push_sr_change(sd, prev, sr, provisional);
+
+	// Update overlay text
+	update_overlay_text(sd, sr, provisional);
+
+	// POST to API. Only confirmed changes go out: a provisional value
+	// must not hold up its own verification behind a request, and one
+	// that falls back to prev never left the plugin.
+	if (!provisional && sr != prev && sd->api.is_configured()) {
+		SR_TRACE_SCOPE("api_send");
+		sd->api.send_sr(sr);
+	}
+}
+
 static void sr_worker_thread(SrSourceData *sd)
 {
 	sr_log_info("Worker thread started");
+	sr_trace_set_thread_name("sr_worker");
 
 	while (sd->running.load()) {
 		// Wait for a new frame or shutdown
+		bool ready;
 		{
 			std::unique_lock<std::mutex> lock(sd->frame_mutex);
 			sd->frame_cv.wait_for(lock,
@@ -46,57 +297,122 @@ static void sr_worker_thread(SrSourceData *sd)
 			if (!sd->running.load())
 				break;
 
-			if (!sd->frame_ready)
-				continue;
-
+			ready = sd->frame_ready;
 			sd->frame_ready = false;
 		}
 
+		// Ship batches that aged out. Every pass, not just idle
+		// wakeups: with frames arriving back to back a partial batch
+		// would otherwise wait until it fills up.
+		sd->api.poll_batch();
+		if (!ready)
+			continue;
+
 		// Run OCR on the captured pixels
 		int sr = -1;
+		int confidence = 0;
+		bool provisional = false;
+		bool speculative = sd->speculative.load();
+		bool gate_enabled = sd->gate_enabled.load();
+		bool gated = false;
+		uint64_t ocr_start = os_gettime_ns();
 		{
+			uint64_t wait_begin = sr_trace_now_ns();
 			std::lock_guard<std::mutex> lock(sd->frame_mutex);
-			if (!sd->pixel_buffer.empty() &&
+			sr_trace_event("frame_mutex_wait", wait_begin,
+				       sr_trace_now_ns());
+
+			if (gate_enabled && !sd->pixel_buffer.empty()) {
+				SR_TRACE_SCOPE("screen_gate");
+				gated = !sd->gate.check(sd->pixel_buffer.data(),
+							sd->pixel_linesize,
+							sd->pixel_width,
+							sd->pixel_height,
+							sd->region);
+			}
+
+			if (!gated && !sd->pixel_buffer.empty() &&
 			    sd->ocr.is_initialized()) {
-				sr = sd->ocr.recognize(sd->pixel_buffer.data(),
-						       sd->pixel_linesize,
-						       sd->region);
+				SR_TRACE_SCOPE("ocr");
+				if (speculative)
+					sr = sd->ocr.recognize_fast(
+						sd->pixel_buffer.data(),
+						sd->pixel_linesize, sd->region,
+						provisional, &confidence);
+				else
+					sr = sd->ocr.recognize(
+						sd->pixel_buffer.data(),
+						sd->pixel_linesize, sd->region,
+						&confidence);
 			}
 		}
 
-		if (sr < 0)
+		sd->captures_processed++;
+
+		// Not the SR screen: nothing to read, and not an OCR failure
+		if (gated) {
+			push_pipeline_stats(sd, 0.0);
 			continue;
+		}
 
 		int prev = sd->current_sr.load();
-		if (sr == prev)
-			continue;
+		bool shown = false;
+		int guess = -1;
+
+		// Speculative mode: show a template match right away, then let
+		// Tesseract confirm or correct it outside the frame lock
+		if (speculative && (sr < 0 || provisional)) {
+			guess = sr;
+			if (provisional && guess != prev) {
+				sr_log_info(
+					"SR changed: %d -> %d (provisional)",
+					prev, guess);
+				publish_sr(sd, prev, guess, confidence, true);
+				shown = true;
+			}
 
-		sd->current_sr.store(sr);
-		sr_log_info("SR changed: %d -> %d", prev, sr);
+			uint64_t verify_begin = sr_trace_now_ns();
+			sr = sd->ocr.verify(&confidence);
+			sr_trace_event("ocr_verify", verify_begin,
+				       sr_trace_now_ns());
 
-		// Update overlay text
-		if (sd->text_source) {
-			std::string fmt = sd->display_format;
-			std::string sr_str = std::to_string(sr);
-
-			// Replace {sr} placeholder
-			size_t pos = fmt.find("{sr}");
-			if (pos != std::string::npos)
-				fmt.replace(pos, 4, sr_str);
-			else
-				fmt = "SR: " + sr_str;
-
-			obs_data_t *text_settings = obs_data_create();
-			obs_data_set_string(text_settings, "text",
-					    fmt.c_str());
-			obs_source_update(sd->text_source, text_settings);
-			obs_data_release(text_settings);
+			if (shown && sr != guess)
+				sr_log_info("SR correction: %d -> %d", guess,
+					    sr >= 0 ? sr : prev);
 		}
 
-		// POST to API
-		if (sd->api.is_configured()) {
-			sd->api.send_sr(sr);
+		if (sr >= 0)
+			save_warm_state(sd, sr, confidence);
+
+		// Remember what the screen around a confident read looks like
+		if (gate_enabled && sr >= 0 &&
+		    confidence >= OCR_CACHE_MIN_CONFIDENCE)
+			sd->gate.learn();
+
+		if (sr < 0)
+			sd->ocr_failures++;
+		double ocr_ms = (double)(os_gettime_ns() - ocr_start) / 1e6;
+		push_pipeline_stats(sd, ocr_ms);
+
+		// Confirm, correct or retract the provisional value
+		if (shown) {
+			int confirmed = sr >= 0 ? sr : prev;
+			if (confirmed >= 0) {
+				publish_sr(sd, prev, confirmed, confidence,
+					   false);
+			} else {
+				sd->current_sr.store(prev);
+				push_sr_retraction(sd, guess);
+				clear_overlay_text(sd);
+			}
+			continue;
 		}
+
+		if (sr < 0 || sr == prev)
+			continue;
+
+		sr_log_info("SR changed: %d -> %d", prev, sr);
+		publish_sr(sd, prev, sr, confidence, false);
 	}
 
 	sr_log_info("Worker thread stopped");
@@ -127,6 +443,32 @@ static std::string get_tessdata_path()
 	return "tessdata";
 }
 
+/* ------------------------------------------------------------------ */
+/* Helper: per-source state files in the module config directory      */
+/* ------------------------------------------------------------------ */
+
+static std::string get_source_file_path(obs_source_t *source,
+					const char *prefix)
+{
+	std::string name = prefix;
+	name += obs_source_get_uuid(source);
+	name += ".bin";
+
+	char *path = obs_module_config_path(name.c_str());
+	if (!path)
+		return name;
+
+	std::string result(path);
+	bfree(path);
+
+	// Make sure the config directory exists
+	size_t slash = result.find_last_of("/\\");
+	if (slash != std::string::npos)
+		os_mkdirs(result.substr(0, slash).c_str());
+
+	return result;
+}
+
 /* ------------------------------------------------------------------ */
 /* Source callbacks                                                     */
 /* ------------------------------------------------------------------ */
@@ -152,7 +494,17 @@ static void *sr_create(obs_data_t *settings, obs_source_t *source)
 	sd->manual_sr = 0;
 	sd->time_since_capture = 0.0f;
 	sd->text_source = nullptr;
+	sd->overlay_settings = nullptr;
 	sd->display_format = "SR: {sr}";
+	sd->push_stats.store(false);
+	sd->cache_persist = false;
+	sd->speculative.store(false);
+	sd->gate_enabled.store(false);
+	sd->warm_sr = -1;
+	sd->warm_revision = 0;
+	sd->trace_owner = false;
+	sd->captures_processed = 0;
+	sd->ocr_failures = 0;
 
 	// Initialize OCR engine
 	std::string tessdata = get_tessdata_path();
@@ -185,9 +537,32 @@ static void *sr_create(obs_data_t *settings, obs_source_t *source)
 	if (!sd->text_source)
 		sr_log_warn("Failed to create text source for overlay");
 
+	// Reused for every overlay update
+	sd->overlay_settings = obs_data_create();
+	sd->overlay_text.reserve(128);
+
+	// Map the persistent SR history before settings can record into it
+	std::string history_path =
+		get_source_file_path(source, "sr-history-");
+	sd->history.open(history_path);
+	SrAggregates agg = sd->history.aggregates();
+	if (agg.current >= 0) {
+		sd->current_sr.store(agg.current);
+		update_overlay_text(sd, agg.current);
+	}
+
 	// Apply initial settings
 	sr_update(sd, settings);
 
+	if (sd->cache_persist)
+		sd->ocr.cache().load(
+			get_source_file_path(source, "ocr-cache-"));
+
+	// Start from what the last session learned instead of from zero
+	std::string warm_path = get_source_file_path(source, "warm-state-");
+	restore_warm_state(sd, warm_path);
+	sd->warm_writer.start(warm_path);
+
 	// Start worker thread
 	sd->running.store(true);
 	sd->worker_thread = std::thread(sr_worker_thread, sd);
@@ -200,17 +575,38 @@ static void sr_destroy(void *data)
 {
 	auto *sd = static_cast<SrSourceData *>(data);
 
-	// Stop worker thread
+	// Stop worker thread. Queued SR changes are uploaded first, and a
+	// request still running after the grace period is aborted, so
+	// neither this join nor the final drain below can hold up OBS for a
+	// full request timeout.
 	sd->running.store(false);
 	sd->frame_cv.notify_all();
+	sd->api.begin_shutdown(API_SHUTDOWN_GRACE_MS);
 	if (sd->worker_thread.joinable())
 		sd->worker_thread.join();
 
+	// The worker may have queued one last change while stopping
+	sd->api.drain_batch();
+	UploadStats upload = sd->api.get_stats();
+	size_t unsent = sd->api.pending_events();
+	if (upload.dropped_events || unsent)
+		sr_log_warn("%llu SR events dropped past the upload backlog, "
+			    "%zu never sent",
+			    (unsigned long long)upload.dropped_events, unsent);
+
+	// Writes the last snapshot the worker scheduled
+	sd->warm_writer.stop();
+
+	sd->push.stop();
+
+	sr_trace_stop(sd);
+
 	// Clean up text source
 	if (sd->text_source) {
 		obs_source_release(sd->text_source);
 		sd->text_source = nullptr;
 	}
+	obs_data_release(sd->overlay_settings);
 
 	// Clean up graphics resources
 	obs_enter_graphics();
@@ -225,8 +621,13 @@ static void sr_destroy(void *data)
 	obs_leave_graphics();
 
 	// Shutdown OCR
+	if (sd->cache_persist)
+		sd->ocr.cache().save(
+			get_source_file_path(sd->self, "ocr-cache-"));
 	sd->ocr.shutdown();
 
+	sd->history.close();
+
 	sr_log_info("SR source destroyed");
 	delete sd;
 }
@@ -243,6 +644,20 @@ static void sr_get_defaults(obs_data_t *settings)
 	obs_data_set_default_string(settings, S_API_KEY, "");
 	obs_data_set_default_int(settings, S_MANUAL_SR, 0);
 	obs_data_set_default_string(settings, S_DISPLAY_FORMAT, "SR: {sr}");
+	obs_data_set_default_bool(settings, S_PUSH_ENABLED, false);
+	obs_data_set_default_int(settings, S_PUSH_PORT, 4460);
+	obs_data_set_default_bool(settings, S_PUSH_STATS, false);
+	obs_data_set_default_string(settings, S_PUSH_ORIGINS, "");
+	obs_data_set_default_int(settings, S_UPLOAD_MODE,
+				 (int)UploadMode::Single);
+	obs_data_set_default_int(settings, S_BATCH_MAX_EVENTS, 50);
+	obs_data_set_default_int(settings, S_BATCH_MAX_AGE, 30);
+	obs_data_set_default_bool(settings, S_OCR_CACHE_PERSIST, false);
+	obs_data_set_default_bool(settings, S_OCR_SPECULATIVE, false);
+	obs_data_set_default_bool(settings, S_SCREEN_GATE, false);
+	obs_data_set_default_bool(settings, S_TRACE_ENABLED, false);
+	obs_data_set_default_string(settings, S_TRACE_PATH, "");
+	obs_data_set_default_int(settings, S_TRACE_MAX_MB, 64);
 }
 
 /* Callback to populate source dropdown with available video sources */
@@ -272,6 +687,24 @@ static bool test_ocr_clicked(obs_properties_t *, obs_property_t *, void *data)
 			"Test OCR: no SR detected yet — check region settings and source");
 	}
 
+	OcrCacheStats cache = sd->ocr.cache().stats();
+	uint64_t lookups = cache.hits + cache.misses;
+	double hit_rate =
+		lookups ? 100.0 * (double)cache.hits / (double)lookups : 0.0;
+	sr_log_info("Test OCR: cache %llu/%llu hits (%.1f%%), %zu entries",
+		    (unsigned long long)cache.hits,
+		    (unsigned long long)lookups, hit_rate, cache.entries);
+
+	ScreenGateStats gate = sd->gate.stats();
+	double gated_rate = gate.checked ? 100.0 * (double)gate.gated /
+						   (double)gate.checked
+					 : 0.0;
+	sr_log_info("Test OCR: screen gate skipped %llu/%llu captures "
+		    "(%.1f%%), %d screens learned",
+		    (unsigned long long)gate.gated,
+		    (unsigned long long)gate.checked, gated_rate,
+		    gate.references);
+
 	// Trigger an immediate capture by resetting the timer
 	sd->time_since_capture = sd->capture_interval + 1.0f;
 	return true;
@@ -313,6 +746,34 @@ static obs_properties_t *sr_get_properties(void *data)
 				obs_module_text("Setting.ApiKey"),
 				OBS_TEXT_PASSWORD);
 
+	// Recognition cache
+	obs_properties_add_bool(props, S_OCR_CACHE_PERSIST,
+				obs_module_text("Setting.OcrCachePersist"));
+	obs_properties_add_bool(props, S_OCR_SPECULATIVE,
+				obs_module_text("Setting.OcrSpeculative"));
+	obs_properties_add_bool(props, S_SCREEN_GATE,
+				obs_module_text("Setting.ScreenGate"));
+
+	// Upload batching
+	obs_property_t *upload_list = obs_properties_add_list(
+		props, S_UPLOAD_MODE, obs_module_text("Setting.UploadMode"),
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(upload_list,
+				  obs_module_text("Setting.UploadMode.Single"),
+				  (int)UploadMode::Single);
+	obs_property_list_add_int(upload_list,
+				  obs_module_text("Setting.UploadMode.GzipJson"),
+				  (int)UploadMode::GzipJson);
+	obs_property_list_add_int(upload_list,
+				  obs_module_text("Setting.UploadMode.Binary"),
+				  (int)UploadMode::BinaryBatch);
+	obs_properties_add_int(props, S_BATCH_MAX_EVENTS,
+			       obs_module_text("Setting.BatchMaxEvents"), 1,
+			       1000, 1);
+	obs_properties_add_int(props, S_BATCH_MAX_AGE,
+			       obs_module_text("Setting.BatchMaxAge"), 1, 3600,
+			       1);
+
 	// Manual SR override
 	obs_properties_add_int(props, S_MANUAL_SR,
 			       obs_module_text("Setting.ManualSR"), 0, 99999,
@@ -323,6 +784,28 @@ static obs_properties_t *sr_get_properties(void *data)
 				obs_module_text("Setting.DisplayFormat"),
 				OBS_TEXT_DEFAULT);
 
+	// Local push server for browser-source overlays
+	obs_properties_add_bool(props, S_PUSH_ENABLED,
+				obs_module_text("Setting.PushEnabled"));
+	obs_properties_add_int(props, S_PUSH_PORT,
+			       obs_module_text("Setting.PushPort"), 1024, 65535,
+			       1);
+	obs_properties_add_bool(props, S_PUSH_STATS,
+				obs_module_text("Setting.PushStats"));
+	obs_properties_add_text(props, S_PUSH_ORIGINS,
+				obs_module_text("Setting.PushOrigins"),
+				OBS_TEXT_DEFAULT);
+
+	// Pipeline tracing (Chrome/Perfetto trace-event JSON)
+	obs_properties_add_bool(props, S_TRACE_ENABLED,
+				obs_module_text("Setting.TraceEnabled"));
+	obs_properties_add_path(props, S_TRACE_PATH,
+				obs_module_text("Setting.TracePath"),
+				OBS_PATH_FILE_SAVE, "Trace (*.json)", nullptr);
+	obs_properties_add_int(props, S_TRACE_MAX_MB,
+			       obs_module_text("Setting.TraceMaxMB"), 1, 1024,
+			       1);
+
 	// Test OCR button
 	obs_properties_add_button2(props, S_TEST_OCR,
 				   obs_module_text("Setting.TestOCR"),
@@ -346,48 +829,84 @@ static void sr_update(void *data, obs_data_t *settings)
 	sd->capture_interval =
 		(float)obs_data_get_double(settings, S_CAPTURE_INTERVAL);
 
-	sd->display_format =
-		obs_data_get_string(settings, S_DISPLAY_FORMAT);
-	if (sd->display_format.empty())
-		sd->display_format = "SR: {sr}";
+	sd->cache_persist = obs_data_get_bool(settings, S_OCR_CACHE_PERSIST);
+	sd->speculative.store(obs_data_get_bool(settings, S_OCR_SPECULATIVE));
+	sd->gate_enabled.store(obs_data_get_bool(settings, S_SCREEN_GATE));
+
+	{
+		std::lock_guard<std::mutex> lock(sd->overlay_mutex);
+		sd->display_format =
+			obs_data_get_string(settings, S_DISPLAY_FORMAT);
+		if (sd->display_format.empty())
+			sd->display_format = "SR: {sr}";
+	}
 
 	// API configuration
 	std::string url = obs_data_get_string(settings, S_API_URL);
 	std::string key = obs_data_get_string(settings, S_API_KEY);
 	sd->api.configure(url, key);
+	sd->api.configure_batching(
+		(UploadMode)obs_data_get_int(settings, S_UPLOAD_MODE),
+		(size_t)obs_data_get_int(settings, S_BATCH_MAX_EVENTS),
+		(int)obs_data_get_int(settings, S_BATCH_MAX_AGE));
+
+	// Push server: (re)start only when the port or enabled state changes
+	bool push_enabled = obs_data_get_bool(settings, S_PUSH_ENABLED);
+	uint16_t push_port = (uint16_t)obs_data_get_int(settings, S_PUSH_PORT);
+	sd->push_stats.store(obs_data_get_bool(settings, S_PUSH_STATS));
+	sd->push.set_allowed_origins(
+		obs_data_get_string(settings, S_PUSH_ORIGINS));
+
+	if (!push_enabled) {
+		sd->push.stop();
+	} else if (!sd->push.is_running() || sd->push.port() != push_port) {
+		sd->push.start(push_port);
+	}
+
+	// Tracing is process-wide with one owner. While another source's trace
+	// runs, starting fails and is retried on this source's next update.
+	bool trace_on = obs_data_get_bool(settings, S_TRACE_ENABLED);
+	std::string trace_path = obs_data_get_string(settings, S_TRACE_PATH);
+	size_t trace_max =
+		(size_t)obs_data_get_int(settings, S_TRACE_MAX_MB) * 1024 * 1024;
+
+	if (trace_on) {
+		if (trace_path.empty()) {
+			char *path = obs_module_config_path("sr-trace.json");
+			if (path) {
+				trace_path = path;
+				bfree(path);
+			}
+		}
+		if (!sd->trace_owner || trace_path != sd->trace_path) {
+			sd->trace_owner =
+				sr_trace_start(sd, trace_path, trace_max);
+			sd->trace_path = trace_path;
+		}
+	} else if (sd->trace_owner) {
+		sr_trace_stop(sd);
+		sd->trace_owner = false;
+	}
 
 	// Manual SR override
 	int manual = (int)obs_data_get_int(settings, S_MANUAL_SR);
 	sd->manual_sr = manual;
 
 	if (manual > 0) {
-		sd->current_sr.store(manual);
+		int prev = sd->current_sr.exchange(manual);
+		if (prev != manual) {
+			sd->history.record(manual, 100,
+					   (int64_t)std::time(nullptr));
+			push_sr_change(sd, prev, manual);
+		}
 
 		// Update overlay text immediately
-		if (sd->text_source) {
-			std::string fmt = sd->display_format;
-			std::string sr_str = std::to_string(manual);
-			size_t pos = fmt.find("{sr}");
-			if (pos != std::string::npos)
-				fmt.replace(pos, 4, sr_str);
-			else
-				fmt = "SR: " + sr_str;
-
-			obs_data_t *text_settings = obs_data_create();
-			obs_data_set_string(text_settings, "text",
-					    fmt.c_str());
-			obs_source_update(sd->text_source, text_settings);
-			obs_data_release(text_settings);
-		}
+		update_overlay_text(sd, manual);
 
-		// Also POST to API if configured
-		if (sd->api.is_configured()) {
-			// Do this in a detached thread to avoid blocking the UI
-			int sr_val = manual;
-			std::thread([sd, sr_val] {
-				sd->api.send_sr(sr_val);
-			}).detach();
-		}
+		// Also POST to API if configured. The API client's transport
+		// thread finishes the request, so the UI never waits on it
+		if (sd->api.is_configured())
+			sd->api.send_sr_async(manual);
 	}
 }
 
@@ -409,6 +928,13 @@ static void sr_video_tick(void *data, float seconds)
 		return;
 	sd->time_since_capture = 0.0f;
 
+	static thread_local bool trace_named = false;
+	if (!trace_named && sr_trace_enabled()) {
+		sr_trace_set_thread_name("obs_graphics");
+		trace_named = true;
+	}
+	SR_TRACE_SCOPE("video_tick_capture");
+
 	// Need a target source
 	if (sd->target_source_name.empty())
 		return;
@@ -439,6 +965,7 @@ static void sr_video_tick(void *data, float seconds)
 		return;
 	}
 
+	uint64_t render_begin = sr_trace_now_ns();
 	gs_texrender_reset(sd->texrender);
 
 	if (!gs_texrender_begin(sd->texrender, target_w, target_h)) {
@@ -452,6 +979,7 @@ static void sr_video_tick(void *data, float seconds)
 
 	obs_source_video_render(target);
 	gs_texrender_end(sd->texrender);
+	sr_trace_event("texrender", render_begin, sr_trace_now_ns());
 
 	obs_source_release(target);
 
@@ -476,17 +1004,26 @@ static void sr_video_tick(void *data, float seconds)
 		return;
 
 	// Stage the texture (GPU → CPU)
+	uint64_t stage_begin = sr_trace_now_ns();
 	gs_stage_texture(sd->stagesurface, tex);
 
 	uint8_t *stage_data = nullptr;
 	uint32_t linesize = 0;
 
-	if (!gs_stagesurface_map(sd->stagesurface, &stage_data, &linesize))
+	bool mapped =
+		gs_stagesurface_map(sd->stagesurface, &stage_data, &linesize);
+	sr_trace_event("stage_map", stage_begin, sr_trace_now_ns());
+	if (!mapped)
 		return;
 
 	// Copy the pixel data into the shared buffer
 	{
+		uint64_t wait_begin = sr_trace_now_ns();
 		std::lock_guard<std::mutex> lock(sd->frame_mutex);
+		sr_trace_event("frame_mutex_wait", wait_begin,
+			       sr_trace_now_ns());
+		SR_TRACE_SCOPE("frame_copy");
+
 		size_t total_size = (size_t)linesize * target_h;
 		sd->pixel_buffer.resize(total_size);
 		std::memcpy(sd->pixel_buffer.data(), stage_data, total_size);
@@ -10,6 +10,10 @@
 
 #include "ocr-engine.h"
 #include "api-client.h"
+#include "push-server.h"
+#include "sr-history.h"
+#include "warm-state.h"
+#include "screen-gate.h"
 
 // Settings keys
 #define S_SOURCE_NAME "source_name"
@@ -26,6 +30,19 @@
 #define S_FONT "font"
 #define S_FONT_SIZE "font_size"
 #define S_FONT_COLOR "font_color"
+#define S_PUSH_ENABLED "push_enabled"
+#define S_PUSH_PORT "push_port"
+#define S_PUSH_STATS "push_stats"
+#define S_PUSH_ORIGINS "push_allowed_origins"
+#define S_UPLOAD_MODE "upload_mode"
+#define S_BATCH_MAX_EVENTS "batch_max_events"
+#define S_BATCH_MAX_AGE "batch_max_age"
+#define S_OCR_CACHE_PERSIST "ocr_cache_persist"
+#define S_OCR_SPECULATIVE "ocr_speculative"
+#define S_SCREEN_GATE "screen_gate"
+#define S_TRACE_ENABLED "trace_enabled"
+#define S_TRACE_PATH "trace_path"
+#define S_TRACE_MAX_MB "trace_max_mb"
 
 struct SrSourceData {
 	obs_source_t *self;
@@ -57,17 +74,45 @@ struct SrSourceData {
 
 	// OCR engine
 	OcrEngine ocr;
+	bool cache_persist;
+	std::atomic<bool> speculative;
+
+	// Skips OCR on frames that don't show the SR screen
+	ScreenGate gate;
+	std::atomic<bool> gate_enabled;
+
+	// Learned state carried into the next session (worker thread only)
+	WarmStateWriter warm_writer;
+	int warm_sr;
+	uint64_t warm_revision;
 
 	// API client
 	ApiClient api;
 
+	// Local push server for browser-source overlays
+	PushServer push;
+	std::atomic<bool> push_stats;
+
+	// Pipeline tracing started by this source
+	bool trace_owner;
+	std::string trace_path;
+
+	// Pipeline counters (worker thread only)
+	uint64_t captures_processed;
+	uint64_t ocr_failures;
+
 	// Current SR value
 	std::atomic<int> current_sr;
+	SrHistory history;
 	int manual_sr;
 
 	// Text overlay (internal text_gdiplus source)
 	obs_source_t *text_source;
+	std::mutex overlay_mutex;
 	std::string display_format;
+	// Overlay update scratch, reused across updates (overlay_mutex)
+	obs_data_t *overlay_settings;
+	std::string overlay_text;
 
 	// Worker thread
 	std::thread worker_thread;
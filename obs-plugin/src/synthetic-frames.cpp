@@ -0,0 +1,331 @@
+#include "synthetic-frames.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#define GLYPH_W 5
+#define GLYPH_H 7
+#define SUPERSAMPLE 4
+
+// 5x7 bitmap digits, one row per byte, bit 4 = leftmost column
+static const uint8_t BITMAP_DIGITS[10][GLYPH_H] = {
+	{0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}, // 0
+	{0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E}, // 1
+	{0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}, // 2
+	{0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E}, // 3
+	{0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}, // 4
+	{0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E}, // 5
+	{0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}, // 6
+	{0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}, // 7
+	{0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}, // 8
+	{0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C}, // 9
+};
+
+// Segments a-g per digit, bit 0 = a (top) ... bit 6 = g (middle)
+static const uint8_t SEGMENT_DIGITS[10] = {0x3F, 0x06, 0x5B, 0x4F, 0x66,
+					   0x6D, 0x7D, 0x07, 0x7F, 0x6F};
+
+/* Glyph coverage at normalized glyph coordinates (u in [0,5), v in [0,7)) */
+static bool glyph_hit(SyntheticFont font, char c, float u, float v)
+{
+	if (c == ',') {
+		// Short descending tick in the bottom-left cell
+		return u >= 0.0f && u < 1.0f && v >= 5.5f && v < 7.0f;
+	}
+
+	int d = c - '0';
+	if (d < 0 || d > 9)
+		return false;
+
+	if (font == SyntheticFont::Bitmap) {
+		int col = (int)u;
+		int row = (int)v;
+		if (col < 0 || col >= GLYPH_W || row < 0 || row >= GLYPH_H)
+			return false;
+		return (BITMAP_DIGITS[d][row] >> (GLYPH_W - 1 - col)) & 1;
+	}
+
+	// Segment font: 0.8-unit strokes with small gaps at the joints
+	const float t = 0.8f;
+	const float gap = 0.25f;
+	uint8_t segs = SEGMENT_DIGITS[d];
+	bool span = u >= t / 2 && u < GLYPH_W - t / 2;
+	bool top = span && v < t;
+	bool mid = span && std::fabs(v - 3.5f) < t / 2;
+	bool bottom = span && v >= GLYPH_H - t;
+	bool left = u < t, right = u >= GLYPH_W - t;
+	bool upper = v >= t / 2 + gap && v < 3.5f - gap;
+	bool lower = v >= 3.5f + gap && v < GLYPH_H - t / 2 - gap;
+
+	return ((segs & 0x01) && top) || ((segs & 0x02) && right && upper) ||
+	       ((segs & 0x04) && right && lower) ||
+	       ((segs & 0x08) && bottom) || ((segs & 0x10) && left && lower) ||
+	       ((segs & 0x20) && left && upper) || ((segs & 0x40) && mid);
+}
+
+/* Coverage of a whole string: digits advance 6 cells, separators 2 */
+static bool text_hit(SyntheticFont font, const std::string &text, float u,
+		     float v)
+{
+	float cursor = 0.0f;
+	for (char c : text) {
+		float adv = (c == ',') ? 2.0f : 6.0f;
+		if (u < cursor + adv)
+			return glyph_hit(font, c, u - cursor, v);
+		cursor += adv;
+	}
+	return false;
+}
+
+static uint8_t clamp8(float v)
+{
+	return (uint8_t)std::min(255.0f, std::max(0.0f, v + 0.5f));
+}
+
+static std::string sr_text(int sr, bool thousands_sep)
+{
+	std::string digits = std::to_string(sr);
+	if (!thousands_sep || digits.size() <= 3)
+		return digits;
+
+	std::string out;
+	for (size_t i = 0; i < digits.size(); i++) {
+		if (i > 0 && (digits.size() - i) % 3 == 0)
+			out += ',';
+		out += digits[i];
+	}
+	return out;
+}
+
+/* Bilinear resample of a tightly packed BGRA image */
+static void resize_bgra(const std::vector<uint8_t> &src, int sw, int sh,
+			std::vector<uint8_t> &dst, int dw, int dh)
+{
+	dst.assign((size_t)dw * dh * 4, 0);
+	for (int y = 0; y < dh; y++) {
+		float fy = std::max(0.0f, (y + 0.5f) * sh / dh - 0.5f);
+		int y0 = std::min((int)fy, sh - 1);
+		int y1 = std::min(y0 + 1, sh - 1);
+		float wy = fy - y0;
+		for (int x = 0; x < dw; x++) {
+			float fx = std::max(0.0f, (x + 0.5f) * sw / dw - 0.5f);
+			int x0 = std::min((int)fx, sw - 1);
+			int x1 = std::min(x0 + 1, sw - 1);
+			float wx = fx - x0;
+			for (int c = 0; c < 4; c++) {
+				float a = src[((size_t)y0 * sw + x0) * 4 + c];
+				float b = src[((size_t)y0 * sw + x1) * 4 + c];
+				float d = src[((size_t)y1 * sw + x0) * 4 + c];
+				float e = src[((size_t)y1 * sw + x1) * 4 + c];
+				float top = a + (b - a) * wx;
+				float bot = d + (e - d) * wx;
+				dst[((size_t)y * dw + x) * 4 + c] =
+					clamp8(top + (bot - top) * wy);
+			}
+		}
+	}
+}
+
+/* Pull one 8x8 block toward its mean color and quantize it */
+static void block_artifact(SyntheticFrame &f, int bx, int by, float pull,
+			   int quant)
+{
+	int ey = std::min(by + 8, f.height);
+	int ex = std::min(bx + 8, f.width);
+	float count = (float)((ey - by) * (ex - bx));
+
+	for (int k = 0; k < 3; k++) {
+		float sum = 0.0f;
+		for (int y = by; y < ey; y++) {
+			const uint8_t *row = &f.bgra[(size_t)y * f.linesize];
+			for (int x = bx; x < ex; x++)
+				sum += row[x * 4 + k];
+		}
+
+		float mean = sum / count;
+		for (int y = by; y < ey; y++) {
+			uint8_t *row = &f.bgra[(size_t)y * f.linesize];
+			for (int x = bx; x < ex; x++) {
+				float v = row[x * 4 + k];
+				v += (mean - v) * pull;
+				row[x * 4 + k] = clamp8(std::round(v / quant) *
+							quant);
+			}
+		}
+	}
+}
+
+SyntheticFrameGenerator::SyntheticFrameGenerator(uint32_t seed) : rng(seed) {}
+
+SyntheticFrameParams SyntheticFrameGenerator::default_params(int sr)
+{
+	SyntheticFrameParams p;
+	p.sr = sr;
+	p.font = SyntheticFont::Bitmap;
+	p.digit_height = 36;
+	p.thousands_sep = true;
+	p.text_color = 0xFFFFFF;
+	p.bg_color = 0x202630;
+	p.text_alpha = 1.0f;
+	p.resample = 1.0f;
+	p.noise = 0;
+	p.hud_lines = 0;
+	p.compression = 0;
+	p.margin = 16;
+	return p;
+}
+
+SyntheticFrameParams SyntheticFrameGenerator::random_params()
+{
+	auto uni = [this](float lo, float hi) {
+		return std::uniform_real_distribution<float>(lo, hi)(rng);
+	};
+	auto pick = [this](int lo, int hi) {
+		return std::uniform_int_distribution<int>(lo, hi)(rng);
+	};
+
+	SyntheticFrameParams p = default_params(pick(0, 9999));
+	p.font = pick(0, 1) ? SyntheticFont::Segment : SyntheticFont::Bitmap;
+	p.digit_height = pick(18, 56);
+	p.thousands_sep = pick(0, 1) != 0;
+
+	// Bright text over a darker HUD panel, as in the lobby screens
+	int lum = pick(170, 255);
+	p.text_color = ((uint32_t)lum << 16) | ((uint32_t)pick(170, 255) << 8) |
+		       (uint32_t)pick(150, 255);
+	p.bg_color = ((uint32_t)pick(0, 70) << 16) |
+		     ((uint32_t)pick(0, 70) << 8) | (uint32_t)pick(0, 90);
+
+	p.text_alpha = uni(0.7f, 1.0f);
+	p.resample = pick(0, 2) == 0 ? uni(0.6f, 0.95f) : 1.0f;
+	p.noise = pick(0, 24);
+	p.hud_lines = pick(0, 4);
+	p.compression = pick(0, 3);
+	return p;
+}
+
+void SyntheticFrameGenerator::render(const SyntheticFrameParams &params,
+				     SyntheticFrame &out)
+{
+	const std::string text = sr_text(params.sr, params.thousands_sep);
+	const float scale = (float)params.digit_height / GLYPH_H;
+	const int pad = std::max(2, params.digit_height / 4);
+
+	// Layout: digits advance 6 cells, separators 2 cells
+	float text_cells = 0.0f;
+	for (char c : text)
+		text_cells += (c == ',') ? 2.0f : 6.0f;
+
+	int text_w = (int)std::ceil(text_cells * scale);
+	int text_h = params.digit_height;
+
+	out.region.width = text_w + pad * 2;
+	out.region.height = text_h + pad * 2;
+	out.region.x = params.margin;
+	out.region.y = params.margin;
+	out.width = out.region.width + params.margin * 2;
+	out.height = out.region.height + params.margin * 2;
+	out.linesize = out.width * 4;
+
+	std::vector<uint8_t> &px = out.bgra;
+	px.assign((size_t)out.linesize * out.height, 0);
+
+	const float bg_r = (float)((params.bg_color >> 16) & 0xFF);
+	const float bg_g = (float)((params.bg_color >> 8) & 0xFF);
+	const float bg_b = (float)(params.bg_color & 0xFF);
+	const float fg_r = (float)((params.text_color >> 16) & 0xFF);
+	const float fg_g = (float)((params.text_color >> 8) & 0xFF);
+	const float fg_b = (float)(params.text_color & 0xFF);
+
+	// Background: vertical gradient like a HUD panel
+	for (int y = 0; y < out.height; y++) {
+		float shade = 1.0f - 0.25f * (float)y / (float)out.height;
+		for (int x = 0; x < out.width; x++) {
+			uint8_t *p = &px[(size_t)y * out.linesize + x * 4];
+			p[0] = clamp8(bg_b * shade);
+			p[1] = clamp8(bg_g * shade);
+			p[2] = clamp8(bg_r * shade);
+			p[3] = 255;
+		}
+	}
+
+	// HUD clutter: faint full-width/height lines behind the number
+	std::uniform_int_distribution<int> any_y(0, out.height - 1);
+	std::uniform_int_distribution<int> any_x(0, out.width - 1);
+	std::uniform_int_distribution<int> any_c(60, 200);
+	for (int i = 0; i < params.hud_lines; i++) {
+		bool horizontal = (i % 2) == 0;
+		int at = horizontal ? any_y(rng) : any_x(rng);
+		float c = (float)any_c(rng);
+		int len = horizontal ? out.width : out.height;
+		for (int j = 0; j < len; j++) {
+			int x = horizontal ? j : at, y = horizontal ? at : j;
+			uint8_t *p = &px[(size_t)y * out.linesize + x * 4];
+			for (int k = 0; k < 3; k++)
+				p[k] = clamp8(p[k] * 0.6f + c * 0.4f);
+		}
+	}
+
+	// Text with supersampled coverage for anti-aliased edges
+	const int ox = out.region.x + pad;
+	const int oy = out.region.y + pad;
+	const float step = 1.0f / SUPERSAMPLE;
+
+	for (int y = 0; y < text_h; y++) {
+		for (int x = 0; x < text_w; x++) {
+			int hits = 0;
+			for (int sy = 0; sy < SUPERSAMPLE; sy++) {
+				for (int sx = 0; sx < SUPERSAMPLE; sx++) {
+					float cx = (x + (sx + 0.5f) * step) /
+						   scale;
+					float cy = (y + (sy + 0.5f) * step) /
+						   scale;
+					hits += text_hit(params.font, text, cx,
+							 cy);
+				}
+			}
+			if (!hits)
+				continue;
+
+			float a = params.text_alpha * (float)hits /
+				  (SUPERSAMPLE * SUPERSAMPLE);
+			uint8_t *p = &px[(size_t)(oy + y) * out.linesize +
+					 (ox + x) * 4];
+			p[0] = clamp8(p[0] + (fg_b - p[0]) * a);
+			p[1] = clamp8(p[1] + (fg_g - p[1]) * a);
+			p[2] = clamp8(p[2] + (fg_r - p[2]) * a);
+		}
+	}
+
+	// Scaling: capture at lower resolution and stretch back up
+	if (params.resample > 0.0f && params.resample < 1.0f) {
+		int sw = std::max(1, (int)(out.width * params.resample));
+		int sh = std::max(1, (int)(out.height * params.resample));
+		std::vector<uint8_t> small;
+		resize_bgra(px, out.width, out.height, small, sw, sh);
+		resize_bgra(small, sw, sh, px, out.width, out.height);
+	}
+
+	// Sensor/encoder noise
+	if (params.noise > 0) {
+		std::uniform_int_distribution<int> n(-params.noise,
+						     params.noise);
+		for (size_t i = 0; i < px.size(); i += 4) {
+			int delta = n(rng);
+			for (int k = 0; k < 3; k++)
+				px[i + k] = clamp8((float)px[i + k] + delta);
+		}
+	}
+
+	// Compression: pull 8x8 blocks toward their mean and quantize,
+	// approximating the blocking of a low-bitrate stream
+	if (params.compression > 0) {
+		float pull = std::min(0.6f, 0.15f * params.compression);
+		int quant = 4 << std::min(params.compression, 3);
+		for (int by = 0; by < out.height; by += 8) {
+			for (int bx = 0; bx < out.width; bx += 8)
+				block_artifact(out, bx, by, pull, quant);
+		}
+	}
+}
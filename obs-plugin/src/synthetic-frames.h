@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <random>
+#include <cstdint>
+
+#include "ocr-engine.h"
+
+enum class SyntheticFont {
+	Bitmap = 0,     // 5x7 pixel font, HUD-style
+	Segment = 1,    // 7-segment style strokes
+};
+
+struct SyntheticFrameParams {
+	int sr;
+	SyntheticFont font;
+	int digit_height;       // rendered glyph height in pixels
+	bool thousands_sep;     // render 2450 as "2,450"
+	uint32_t text_color;    // 0xRRGGBB
+	uint32_t bg_color;      // 0xRRGGBB
+	float text_alpha;       // 1.0 = opaque, lower = translucent HUD text
+	float resample;         // 1.0 = none, <1.0 = downscale then back up
+	int noise;              // per-pixel noise amplitude (0-64)
+	int hud_lines;          // random translucent lines behind the text
+	int compression;        // 0 = off, higher = stronger 8x8 blocking
+	int margin;             // frame border around the OCR region
+};
+
+struct SyntheticFrame {
+	std::vector<uint8_t> bgra;
+	int width;
+	int height;
+	int linesize;
+	OcrRegion region; // tight box around the rendered number
+};
+
+/**
+ * Renders SR numbers into BGRA frames that look like a captured game HUD,
+ * so OCR changes can be exercised without launching the game.
+ */
+class SyntheticFrameGenerator {
+public:
+	explicit SyntheticFrameGenerator(uint32_t seed = 1);
+
+	void render(const SyntheticFrameParams &params, SyntheticFrame &out);
+
+	/** Draw a plausible HUD sample: SR, font, colors and artifacts */
+	SyntheticFrameParams random_params();
+
+	static SyntheticFrameParams default_params(int sr);
+
+private:
+	std::mt19937 rng;
+};
@@ -0,0 +1,363 @@
+#include "trace.h"
+#include "plugin-support.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// How often the flusher drains the per-thread rings
+#define TRACE_FLUSH_INTERVAL_MS 100
+
+struct TraceEvent {
+	const char *name;
+	uint64_t begin_ns;
+	uint64_t end_ns;
+};
+
+/* Single-producer (owning thread) / single-consumer (flusher) ring */
+struct TraceBuffer {
+	TraceEvent events[SR_TRACE_BUFFER_EVENTS];
+	std::atomic<uint32_t> head{0};
+	std::atomic<uint32_t> tail{0};
+	std::atomic<uint64_t> dropped{0};
+	uint32_t tid = 0;
+	std::string name;      // guarded by TraceState::registry_mutex
+	bool name_written = false; // flusher only
+	bool retired = false;  // owner exited (registry_mutex)
+};
+
+struct TraceState {
+	std::atomic<bool> active{false};
+
+	// Serializes start/stop; owner is whoever started the running trace
+	std::mutex owner_mutex;
+	const void *owner = nullptr;
+	std::string path;
+
+	// Rings of live threads. A thread that exits while tracing is on
+	// leaves its ring here, retired, until the flusher has drained it;
+	// drained rings wait in free_buffers for the next thread and are
+	// freed when tracing stops.
+	std::mutex registry_mutex;
+	std::vector<std::unique_ptr<TraceBuffer>> buffers;
+	std::vector<std::unique_ptr<TraceBuffer>> free_buffers;
+	uint32_t next_tid = 0;
+
+	std::mutex control_mutex;
+	std::condition_variable control_cv;
+	std::thread flusher;
+	bool stop_requested = false;
+
+	FILE *out = nullptr;
+	size_t written = 0;
+	size_t max_bytes = 0;
+	bool first_event = true;
+	uint64_t origin_ns = 0;
+};
+
+static TraceState &state()
+{
+	static TraceState s;
+	return s;
+}
+
+/*
+ * Per-thread handle. Naming a thread only stores the name; the ring is
+ * taken on the first event recorded while tracing is on and handed back
+ * when the thread exits, so threads that come and go with each source
+ * don't pile up rings.
+ */
+struct ThreadTrace {
+	TraceBuffer *buffer = nullptr;
+	std::string name;
+
+	~ThreadTrace();
+};
+
+static thread_local ThreadTrace local_trace;
+
+static TraceBuffer *get_local_buffer()
+{
+	ThreadTrace &local = local_trace;
+	if (local.buffer)
+		return local.buffer;
+
+	TraceState &s = state();
+	std::lock_guard<std::mutex> lock(s.registry_mutex);
+
+	std::unique_ptr<TraceBuffer> buf;
+	if (!s.free_buffers.empty()) {
+		buf = std::move(s.free_buffers.back());
+		s.free_buffers.pop_back();
+		buf->head.store(0);
+		buf->tail.store(0);
+		buf->dropped.store(0);
+		buf->name_written = false;
+		buf->retired = false;
+	} else {
+		buf = std::make_unique<TraceBuffer>();
+	}
+
+	buf->tid = ++s.next_tid;
+	buf->name = local.name;
+	local.buffer = buf.get();
+	s.buffers.push_back(std::move(buf));
+	return local.buffer;
+}
+
+ThreadTrace::~ThreadTrace()
+{
+	if (!buffer)
+		return;
+
+	TraceState &s = state();
+	std::lock_guard<std::mutex> lock(s.registry_mutex);
+
+	// The flusher still owes the file this ring's last events
+	if (s.active.load()) {
+		buffer->retired = true;
+		return;
+	}
+
+	for (size_t i = 0; i < s.buffers.size(); i++) {
+		if (s.buffers[i].get() == buffer) {
+			s.buffers.erase(s.buffers.begin() + i);
+			break;
+		}
+	}
+}
+
+uint64_t sr_trace_now_ns()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		       std::chrono::steady_clock::now().time_since_epoch())
+		.count();
+}
+
+bool sr_trace_enabled()
+{
+	return state().active.load(std::memory_order_relaxed);
+}
+
+void sr_trace_set_thread_name(const char *name)
+{
+	ThreadTrace &local = local_trace;
+	local.name = name;
+	if (!local.buffer)
+		return;
+
+	std::lock_guard<std::mutex> lock(state().registry_mutex);
+	local.buffer->name = name;
+	local.buffer->name_written = false;
+}
+
+void sr_trace_event(const char *name, uint64_t begin_ns, uint64_t end_ns)
+{
+	if (!sr_trace_enabled())
+		return;
+
+	TraceBuffer *buf = get_local_buffer();
+	uint32_t head = buf->head.load(std::memory_order_relaxed);
+	uint32_t tail = buf->tail.load(std::memory_order_acquire);
+
+	if (head - tail >= SR_TRACE_BUFFER_EVENTS) {
+		buf->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	buf->events[head % SR_TRACE_BUFFER_EVENTS] = {name, begin_ns, end_ns};
+	buf->head.store(head + 1, std::memory_order_release);
+}
+
+/* ------------------------------------------------------------------ */
+/* Flusher                                                             */
+/* ------------------------------------------------------------------ */
+
+static void write_record(TraceState &s, const char *text, int len)
+{
+	if (len <= 0 || s.written + (size_t)len + 2 > s.max_bytes)
+		return;
+
+	if (!s.first_event)
+		s.written += fwrite(",\n", 1, 2, s.out);
+	s.first_event = false;
+	s.written += fwrite(text, 1, (size_t)len, s.out);
+}
+
+static void drain_buffers(TraceState &s)
+{
+	char line[256];
+
+	std::lock_guard<std::mutex> lock(s.registry_mutex);
+	for (auto &buf : s.buffers) {
+		if (!buf->name_written && !buf->name.empty()) {
+			int len = snprintf(
+				line, sizeof(line),
+				"{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,"
+				"\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+				buf->tid, buf->name.c_str());
+			write_record(s, line, len);
+			buf->name_written = true;
+		}
+
+		uint32_t tail = buf->tail.load(std::memory_order_relaxed);
+		uint32_t head = buf->head.load(std::memory_order_acquire);
+
+		for (; tail != head; tail++) {
+			const TraceEvent &ev =
+				buf->events[tail % SR_TRACE_BUFFER_EVENTS];
+			if (ev.begin_ns < s.origin_ns)
+				continue;
+
+			// Trace-event timestamps are microseconds
+			int len = snprintf(
+				line, sizeof(line),
+				"{\"ph\":\"X\",\"name\":\"%s\",\"pid\":1,"
+				"\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				ev.name, buf->tid,
+				(double)(ev.begin_ns - s.origin_ns) / 1000.0,
+				(double)(ev.end_ns - ev.begin_ns) / 1000.0);
+			write_record(s, line, len);
+		}
+
+		buf->tail.store(tail, std::memory_order_release);
+	}
+
+	// Drained rings of exited threads can go to the next thread
+	for (size_t i = 0; i < s.buffers.size();) {
+		if (s.buffers[i]->retired) {
+			s.free_buffers.push_back(std::move(s.buffers[i]));
+			s.buffers.erase(s.buffers.begin() + i);
+		} else {
+			i++;
+		}
+	}
+
+	fflush(s.out);
+}
+
+static void flusher_thread()
+{
+	TraceState &s = state();
+	sr_trace_set_thread_name("trace_flusher");
+
+	std::unique_lock<std::mutex> lock(s.control_mutex);
+	while (!s.stop_requested) {
+		s.control_cv.wait_for(
+			lock, std::chrono::milliseconds(TRACE_FLUSH_INTERVAL_MS));
+		drain_buffers(s);
+	}
+}
+
+/* Caller holds owner_mutex */
+static void stop_locked(TraceState &s)
+{
+	if (!s.active.exchange(false))
+		return;
+	s.owner = nullptr;
+
+	{
+		std::lock_guard<std::mutex> lock(s.control_mutex);
+		s.stop_requested = true;
+	}
+	s.control_cv.notify_all();
+	if (s.flusher.joinable())
+		s.flusher.join();
+
+	// Final drain for events recorded after the last flush
+	uint64_t dropped = 0;
+	{
+		std::lock_guard<std::mutex> lock(s.control_mutex);
+		drain_buffers(s);
+		fwrite("\n]\n", 1, 3, s.out);
+		fclose(s.out);
+		s.out = nullptr;
+	}
+	{
+		std::lock_guard<std::mutex> lock(s.registry_mutex);
+		for (auto &buf : s.buffers)
+			dropped += buf->dropped.load();
+		for (auto &buf : s.free_buffers)
+			dropped += buf->dropped.load();
+		s.free_buffers.clear();
+	}
+
+	bool capped = s.written + 256 > s.max_bytes;
+	sr_log_info("Trace: stopped (%zu bytes%s, %llu events dropped)",
+		    s.written, capped ? ", size cap reached" : "",
+		    (unsigned long long)dropped);
+}
+
+bool sr_trace_start(const void *owner, const std::string &path,
+		    size_t max_bytes)
+{
+	TraceState &s = state();
+	std::lock_guard<std::mutex> owner_lock(s.owner_mutex);
+
+	if (s.active.load()) {
+		if (s.owner != owner) {
+			sr_log_warn("Trace: %s is already recording for "
+				    "another source; not starting %s",
+				    s.path.c_str(), path.c_str());
+			return false;
+		}
+		stop_locked(s);
+	}
+
+	FILE *f = fopen(path.c_str(), "wb");
+	if (!f) {
+		sr_log_warn("Trace: cannot open %s", path.c_str());
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(s.control_mutex);
+		s.out = f;
+		s.written = fwrite("[\n", 1, 2, f);
+		s.max_bytes = max_bytes;
+		s.first_event = true;
+		s.stop_requested = false;
+		s.origin_ns = sr_trace_now_ns();
+	}
+
+	// Anything recorded before this trace started belongs to no file
+	{
+		std::lock_guard<std::mutex> lock(s.registry_mutex);
+		for (auto &buf : s.buffers) {
+			buf->tail.store(buf->head.load());
+			buf->dropped.store(0);
+			buf->name_written = false;
+		}
+	}
+
+	s.owner = owner;
+	s.path = path;
+	s.flusher = std::thread(flusher_thread);
+	s.active.store(true);
+
+	sr_log_info("Trace: recording to %s (max %zu bytes)", path.c_str(),
+		    max_bytes);
+	return true;
+}
+
+void sr_trace_stop(const void *owner)
+{
+	TraceState &s = state();
+	std::lock_guard<std::mutex> owner_lock(s.owner_mutex);
+
+	if (s.owner == owner)
+		stop_locked(s);
+}
+
+void sr_trace_shutdown()
+{
+	TraceState &s = state();
+	std::lock_guard<std::mutex> owner_lock(s.owner_mutex);
+
+	stop_locked(s);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+/*
+ * Opt-in pipeline tracing in Chrome/Perfetto trace-event format.
+ *
+ * Each thread records complete ("X") events into its own fixed-size ring
+ * without taking locks; a background thread drains the rings into a JSON
+ * file that chrome://tracing or ui.perfetto.dev can open. While tracing is
+ * off, a scope costs one atomic load.
+ */
+
+// Events buffered per thread between flushes; overflow is dropped
+#define SR_TRACE_BUFFER_EVENTS 8192
+
+/**
+ * Start recording to @p path on behalf of @p owner (any stable pointer,
+ * e.g. the source's data). Tracing is process-wide and has one owner at a
+ * time: if another owner's trace is running this fails and leaves it
+ * alone. The same owner calling again restarts with the new file.
+ */
+bool sr_trace_start(const void *owner, const std::string &path,
+		    size_t max_bytes);
+
+/** Finalize the trace if @p owner started it; otherwise does nothing. */
+void sr_trace_stop(const void *owner);
+
+/** Finalize whatever trace is running, whoever owns it (module unload). */
+void sr_trace_shutdown();
+
+bool sr_trace_enabled();
+
+uint64_t sr_trace_now_ns();
+
+/**
+ * Name the calling thread in the trace viewer. Only stores the name: the
+ * thread's ring is allocated on its first event while tracing is on.
+ */
+void sr_trace_set_thread_name(const char *name);
+
+/**
+ * Record a completed span on the calling thread.
+ * @param name  Must be a string literal (stored by pointer)
+ */
+void sr_trace_event(const char *name, uint64_t begin_ns, uint64_t end_ns);
+
+class SrTraceScope {
+public:
+	explicit SrTraceScope(const char *name_)
+		: name(name_), begin(sr_trace_enabled() ? sr_trace_now_ns() : 0)
+	{
+	}
+	~SrTraceScope()
+	{
+		if (begin)
+			sr_trace_event(name, begin, sr_trace_now_ns());
+	}
+
+	SrTraceScope(const SrTraceScope &) = delete;
+	SrTraceScope &operator=(const SrTraceScope &) = delete;
+
+private:
+	const char *name;
+	uint64_t begin;
+};
+
+#define SR_TRACE_CONCAT_(a, b) a##b
+#define SR_TRACE_CONCAT(a, b) SR_TRACE_CONCAT_(a, b)
+#define SR_TRACE_SCOPE(name) \
+	SrTraceScope SR_TRACE_CONCAT(sr_trace_scope_, __LINE__)(name)
@@ -0,0 +1,157 @@
+#include "warm-state.h"
+#include "plugin-support.h"
+#include "trace.h"
+
+#include <util/platform.h>
+
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+#define WARM_STATE_MAGIC "SRW1"
+
+static_assert(std::is_trivially_copyable<WarmState>::value,
+	      "WarmState is written to disk as raw bytes");
+
+struct WarmStateHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t size; // sizeof(WarmState) when written
+	uint32_t checksum;
+};
+
+static uint32_t fnv1a32(const void *data, size_t len)
+{
+	const uint8_t *p = static_cast<const uint8_t *>(data);
+	uint32_t h = 2166136261u;
+	for (size_t i = 0; i < len; i++) {
+		h ^= p[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+bool warm_state_load(const std::string &path, WarmState &out)
+{
+	FILE *f = fopen(path.c_str(), "rb");
+	if (!f)
+		return false;
+
+	WarmStateHeader header;
+	WarmState state;
+	bool ok = fread(&header, sizeof(header), 1, f) == 1 &&
+		  fread(&state, sizeof(state), 1, f) == 1;
+	fclose(f);
+
+	if (!ok || std::memcmp(header.magic, WARM_STATE_MAGIC, 4) != 0 ||
+	    header.version != WARM_STATE_VERSION ||
+	    header.size != sizeof(WarmState) ||
+	    header.checksum != fnv1a32(&state, sizeof(state))) {
+		sr_log_warn("Warm state: ignoring invalid file %s",
+			    path.c_str());
+		return false;
+	}
+
+	out = state;
+	return true;
+}
+
+static bool write_state(const std::string &path, const WarmState &state)
+{
+	WarmStateHeader header;
+	std::memcpy(header.magic, WARM_STATE_MAGIC, 4);
+	header.version = WARM_STATE_VERSION;
+	header.size = sizeof(WarmState);
+	header.checksum = fnv1a32(&state, sizeof(state));
+
+	std::string tmp = path + ".tmp";
+	FILE *f = fopen(tmp.c_str(), "wb");
+	if (!f)
+		return false;
+
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+		  fwrite(&state, sizeof(state), 1, f) == 1;
+	ok = (fclose(f) == 0) && ok;
+
+	// A crash mid-write leaves the previous file intact
+	if (!ok || os_safe_replace(path.c_str(), tmp.c_str(), nullptr) != 0) {
+		os_unlink(tmp.c_str());
+		sr_log_warn("Warm state: failed to save %s", path.c_str());
+		return false;
+	}
+	return true;
+}
+
+/* ------------------------------------------------------------------ */
+/* WarmStateWriter                                                     */
+/* ------------------------------------------------------------------ */
+
+WarmStateWriter::WarmStateWriter()
+	: pending(), has_pending(false), stop_requested(false)
+{
+}
+
+WarmStateWriter::~WarmStateWriter()
+{
+	stop();
+}
+
+void WarmStateWriter::start(const std::string &path)
+{
+	stop();
+
+	std::lock_guard<std::mutex> lock(writer_mutex);
+	file_path = path;
+	stop_requested = false;
+	writer_thread = std::thread(&WarmStateWriter::run, this);
+}
+
+void WarmStateWriter::schedule(const WarmState &state)
+{
+	{
+		std::lock_guard<std::mutex> lock(writer_mutex);
+		pending = state;
+		has_pending = true;
+	}
+	writer_cv.notify_one();
+}
+
+void WarmStateWriter::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(writer_mutex);
+		stop_requested = true;
+	}
+	writer_cv.notify_one();
+	if (writer_thread.joinable())
+		writer_thread.join();
+}
+
+void WarmStateWriter::run()
+{
+	sr_trace_set_thread_name("warm_state_writer");
+
+	std::unique_lock<std::mutex> lock(writer_mutex);
+	for (;;) {
+		writer_cv.wait(lock, [this] {
+			return has_pending || stop_requested;
+		});
+
+		if (has_pending) {
+			WarmState state = pending;
+			std::string path = file_path;
+			has_pending = false;
+
+			lock.unlock();
+			{
+				SR_TRACE_SCOPE("warm_state_write");
+				write_state(path, state);
+			}
+			lock.lock();
+			continue;
+		}
+
+		if (stop_requested)
+			break;
+	}
+}
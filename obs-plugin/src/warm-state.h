@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <cstdint>
+
+#include "ocr-engine.h"
+#include "digit-templates.h"
+
+// Bump when the WarmState layout changes; older files are ignored
+#define WARM_STATE_VERSION 1
+
+/**
+ * What a source learned in earlier sessions. Plain fixed-layout data with
+ * no pointers, so the file body is the struct and could be mapped as-is.
+ */
+struct WarmState {
+	int32_t last_sr;
+	int32_t last_confidence;
+	int64_t saved_at;
+	// Region the templates were learned from; they only apply to crops of
+	// the same size
+	OcrRegion region;
+	DigitTemplateSet templates;
+};
+
+/**
+ * Read and validate a warm-state file: magic, version, size and checksum
+ * must all match or the file is ignored.
+ */
+bool warm_state_load(const std::string &path, WarmState &out);
+
+/**
+ * Writes warm-state snapshots on a background thread. schedule() only
+ * copies the snapshot; back-to-back snapshots coalesce into one write.
+ * Each write goes to a temporary file that atomically replaces the old one.
+ */
+class WarmStateWriter {
+public:
+	WarmStateWriter();
+	~WarmStateWriter();
+
+	WarmStateWriter(const WarmStateWriter &) = delete;
+	WarmStateWriter &operator=(const WarmStateWriter &) = delete;
+
+	void start(const std::string &path);
+	void schedule(const WarmState &state);
+
+	/** Write any pending snapshot, then stop the thread */
+	void stop();
+
+private:
+	void run();
+
+	std::string file_path;
+	WarmState pending;
+	bool has_pending;
+	bool stop_requested;
+	std::mutex writer_mutex;
+	std::condition_variable writer_cv;
+	std::thread writer_thread;
+};
@@ -0,0 +1,138 @@
+/*
+ * sr-history-test: writes an SrHistory ring past its capacity, reopens the
+ * mapped file and checks that the samples and aggregates read back match.
+ *
+ *   sr-history-test [<scratch dir>]
+ *
+ * Exits non-zero if any check fails.
+ */
+
+#include "sr-history.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+// More than the ring holds, so the write position wraps around
+#define TEST_SAMPLES (SR_HISTORY_CAPACITY + 904)
+
+static int failures = 0;
+
+#define CHECK(cond)                                                      \
+	do {                                                             \
+		if (!(cond)) {                                           \
+			fprintf(stderr, "%s:%d: FAIL: %s\n", __FILE__,   \
+				__LINE__, #cond);                        \
+			failures++;                                      \
+		}                                                        \
+	} while (0)
+
+static int sr_at(int i)
+{
+	// Not monotonic, so the peak and the newest value differ
+	return 1500 + (i * 37) % 1000;
+}
+
+/* The snapshot must hold the newest samples written, oldest first */
+static void check_samples(const SrHistorySnapshot &snap, size_t expected)
+{
+	CHECK(snap.samples.size() == expected);
+	int first = TEST_SAMPLES - (int)snap.samples.size();
+	for (size_t i = 0; i < snap.samples.size(); i++) {
+		const SrSample &s = snap.samples[i];
+		int n = first + (int)i;
+		if (s.sr != sr_at(n) || s.timestamp != 1700000000 + n ||
+		    s.confidence != 80 + n % 20) {
+			fprintf(stderr, "sample %zu: sr %d at %lld\n", i, s.sr,
+				(long long)s.timestamp);
+			CHECK(false);
+			return;
+		}
+	}
+}
+
+static void check_rolling(const SrAggregates &agg)
+{
+	double sum = 0.0;
+	for (int n = TEST_SAMPLES - SR_HISTORY_ROLLING_WINDOW;
+	     n < TEST_SAMPLES; n++)
+		sum += sr_at(n);
+	double expected = sum / SR_HISTORY_ROLLING_WINDOW;
+	CHECK(agg.rolling_avg > expected - 1e-9 &&
+	      agg.rolling_avg < expected + 1e-9);
+}
+
+int main(int argc, char **argv)
+{
+	namespace fs = std::filesystem;
+	fs::path dir = argc > 1 ? fs::path(argv[1]) : fs::temp_directory_path();
+	std::string path = (dir / "sr-history-test.bin").string();
+	std::filesystem::remove(path);
+
+	int peak = 0;
+	for (int n = 0; n < TEST_SAMPLES; n++)
+		peak = std::max(peak, sr_at(n));
+
+	SrHistorySnapshot snap;
+	{
+		SrHistory history;
+		CHECK(history.open(path));
+		CHECK(history.size() == 0);
+
+		history.snapshot(16, snap);
+		CHECK(snap.samples.empty() && snap.total_samples == 0);
+
+		for (int n = 0; n < TEST_SAMPLES; n++)
+			history.record(sr_at(n), 80 + n % 20,
+				       1700000000 + n);
+
+		CHECK(history.size() == SR_HISTORY_CAPACITY);
+		history.snapshot(16, snap);
+		check_samples(snap, 16);
+		CHECK(snap.total_samples == TEST_SAMPLES);
+		CHECK(snap.aggregates.current == sr_at(TEST_SAMPLES - 1));
+		CHECK(snap.aggregates.peak == peak);
+		CHECK(snap.aggregates.session_samples == TEST_SAMPLES);
+		check_rolling(snap.aggregates);
+	}
+
+	// Reopen: the mapped file alone must bring back the whole ring
+	{
+		SrHistory history;
+		CHECK(history.open(path));
+		CHECK(history.size() == SR_HISTORY_CAPACITY);
+
+		history.snapshot(SIZE_MAX, snap);
+		check_samples(snap, SR_HISTORY_CAPACITY);
+		CHECK(snap.total_samples == TEST_SAMPLES);
+		CHECK(snap.aggregates.current == sr_at(TEST_SAMPLES - 1));
+		CHECK(snap.aggregates.peak == peak);
+		CHECK(snap.aggregates.session_samples == 0);
+		check_rolling(snap.aggregates);
+	}
+
+	// A file of the wrong size is reset rather than misread
+	{
+		std::filesystem::resize_file(path, 100);
+		SrHistory history;
+		CHECK(history.open(path));
+		CHECK(history.size() == 0);
+		history.record(2000, 90, 1700000000);
+		history.snapshot(SIZE_MAX, snap);
+		CHECK(snap.samples.size() == 1 &&
+		      snap.samples[0].sr == 2000);
+		CHECK(snap.aggregates.peak == 2000);
+	}
+
+	std::filesystem::remove(path);
+
+	if (failures) {
+		printf("FAIL: %d check(s) failed\n", failures);
+		return 1;
+	}
+	printf("OK: %d samples written, wrapped and read back\n",
+	       TEST_SAMPLES);
+	return 0;
+}
@@ -0,0 +1,288 @@
+/*
+ * sr-api-bench: drives ApiClient against a local mock endpoint and reports
+ * request latency, connections opened and how long callers were blocked.
+ *
+ *   sr-api-bench [--mode single|gzip|binary] [--events N] [--rate R]
+ *                [--producers P] [--batch-size N] [--latency-ms L]
+ *                [--jitter-ms J] [--error-rate E] [--stall-rate S]
+ *                [--stall-ms M] [--reject-binary] [--seed S]
+ *                [--check-batch-age]
+ *
+ * Runs offline: the server is in-process on 127.0.0.1. --check-batch-age
+ * instead fails unless a partial batch goes out once it ages, while frames
+ * keep arriving.
+ */
+
+#include "api-client.h"
+#include "mock-api-server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using bench_clock = std::chrono::steady_clock;
+
+// --check-batch-age: age bound in seconds, and the frame period
+#define AGE_CHECK_MAX_AGE 1
+#define AGE_CHECK_FRAME_MS 16
+
+struct ProducerResult {
+	std::vector<double> blocked_ms; // per send_sr call
+	uint64_t rejected;              // calls that returned false
+};
+
+static double percentile(std::vector<double> v, double p)
+{
+	if (v.empty())
+		return 0.0;
+	std::sort(v.begin(), v.end());
+	size_t idx = (size_t)(p * (double)(v.size() - 1));
+	return v[idx];
+}
+
+static void produce(ApiClient &api, int events, double rate, int base,
+		    ProducerResult &out)
+{
+	out.blocked_ms.reserve((size_t)events);
+	out.rejected = 0;
+
+	auto start = bench_clock::now();
+	for (int i = 0; i < events; i++) {
+		if (rate > 0.0) {
+			auto due = start + std::chrono::microseconds(
+						   (int64_t)(i * 1e6 / rate));
+			std::this_thread::sleep_until(due);
+		}
+
+		auto call = bench_clock::now();
+		if (!api.send_sr(base + i % 500))
+			out.rejected++;
+		out.blocked_ms.push_back(
+			std::chrono::duration<double, std::milli>(
+				bench_clock::now() - call)
+				.count());
+	}
+}
+
+/*
+ * Drives the client the way the source's worker does: a frame every
+ * AGE_CHECK_FRAME_MS, the first few of them changing the SR, and
+ * poll_batch() on every pass. The batch never fills up, so only its age can
+ * send it. Batch ages are counted in whole seconds, so allow one more.
+ */
+static int run_batch_age_check(MockApiServer &server, ApiClient &api)
+{
+	const int changes = 3;
+	api.configure_batching(UploadMode::BinaryBatch, 50, AGE_CHECK_MAX_AGE);
+
+	auto start = bench_clock::now();
+	auto limit = start + std::chrono::seconds(AGE_CHECK_MAX_AGE + 2);
+	int frames = 0;
+	while (server.stats().ok == 0 && bench_clock::now() < limit) {
+		if (frames < changes)
+			api.send_sr(2400 + frames);
+		api.poll_batch();
+		frames++;
+		std::this_thread::sleep_for(
+			std::chrono::milliseconds(AGE_CHECK_FRAME_MS));
+	}
+	double waited =
+		std::chrono::duration<double>(bench_clock::now() - start)
+			.count();
+
+	UploadStats up = api.get_stats();
+	printf("batch age check: %llu of %d events sent after %.2f s and "
+	       "%d frames (max age %d s)\n",
+	       (unsigned long long)up.events, changes, waited, frames,
+	       AGE_CHECK_MAX_AGE);
+
+	if (up.events != (uint64_t)changes) {
+		printf("FAIL: partial batch was not sent once it aged\n");
+		return 1;
+	}
+	printf("OK: partial batch sent on age\n");
+	return 0;
+}
+
+static void usage()
+{
+	fprintf(stderr,
+		"usage: sr-api-bench [--mode single|gzip|binary] [--events N]\n"
+		"                    [--rate R] [--producers P] [--batch-size N]\n"
+		"                    [--latency-ms L] [--jitter-ms J]\n"
+		"                    [--error-rate E] [--stall-rate S]\n"
+		"                    [--stall-ms M] [--reject-binary] [--seed S]\n"
+		"                    [--check-batch-age]\n");
+}
+
+int main(int argc, char **argv)
+{
+	UploadMode mode = UploadMode::Single;
+	int events = 2000;
+	double rate = 0.0;
+	int producers = 1;
+	int batch_size = 50;
+	bool check_batch_age = false;
+
+	MockServerConfig server_cfg = {};
+	server_cfg.stall_ms = 12000;
+	server_cfg.seed = 1;
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		bool has_value = i + 1 < argc;
+		if (!std::strcmp(arg, "--mode") && has_value) {
+			const char *m = argv[++i];
+			if (!std::strcmp(m, "gzip"))
+				mode = UploadMode::GzipJson;
+			else if (!std::strcmp(m, "binary"))
+				mode = UploadMode::BinaryBatch;
+			else if (!std::strcmp(m, "single"))
+				mode = UploadMode::Single;
+			else {
+				usage();
+				return 2;
+			}
+		} else if (!std::strcmp(arg, "--events") && has_value)
+			events = std::atoi(argv[++i]);
+		else if (!std::strcmp(arg, "--rate") && has_value)
+			rate = std::atof(argv[++i]);
+		else if (!std::strcmp(arg, "--producers") && has_value)
+			producers = std::atoi(argv[++i]);
+		else if (!std::strcmp(arg, "--batch-size") && has_value)
+			batch_size = std::atoi(argv[++i]);
+		else if (!std::strcmp(arg, "--latency-ms") && has_value)
+			server_cfg.latency_ms = std::atoi(argv[++i]);
+		else if (!std::strcmp(arg, "--jitter-ms") && has_value)
+			server_cfg.jitter_ms = std::atoi(argv[++i]);
+		else if (!std::strcmp(arg, "--error-rate") && has_value)
+			server_cfg.error_rate = std::atof(argv[++i]);
+		else if (!std::strcmp(arg, "--stall-rate") && has_value)
+			server_cfg.stall_rate = std::atof(argv[++i]);
+		else if (!std::strcmp(arg, "--stall-ms") && has_value)
+			server_cfg.stall_ms = std::atoi(argv[++i]);
+		else if (!std::strcmp(arg, "--reject-binary"))
+			server_cfg.reject_binary = true;
+		else if (!std::strcmp(arg, "--seed") && has_value)
+			server_cfg.seed =
+				(uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		else if (!std::strcmp(arg, "--check-batch-age"))
+			check_batch_age = true;
+		else {
+			usage();
+			return 2;
+		}
+	}
+
+	if (events <= 0 || producers <= 0 || batch_size <= 0) {
+		usage();
+		return 2;
+	}
+
+	MockApiServer server;
+	if (!server.start(server_cfg)) {
+		fprintf(stderr, "mock server failed to start\n");
+		return 2;
+	}
+
+	char url[64];
+	snprintf(url, sizeof(url), "http://127.0.0.1:%u/api/sr",
+		 (unsigned)server.port());
+
+	ApiClient api;
+	api.configure(url, "bench-key");
+	if (check_batch_age)
+		return run_batch_age_check(server, api);
+
+	// Age bound is irrelevant here: only size triggers flushes
+	api.configure_batching(mode, (size_t)batch_size, 3600);
+	api.set_latency_recording(true);
+
+	// Split the events and the offered rate across producers
+	std::vector<ProducerResult> results((size_t)producers);
+	std::vector<std::thread> threads;
+	auto start = bench_clock::now();
+
+	for (int p = 0; p < producers; p++) {
+		int n = events / producers + (p < events % producers ? 1 : 0);
+		threads.emplace_back(produce, std::ref(api), n,
+				     rate / producers, 1000 + p * 1000,
+				     std::ref(results[(size_t)p]));
+	}
+	for (std::thread &t : threads)
+		t.join();
+
+	double produce_s =
+		std::chrono::duration<double>(bench_clock::now() - start)
+			.count();
+
+	// Whatever is still queued goes out now, one batch per request.
+	// drain_batch() stops at the first failed flush, so injected errors
+	// get a few retries before the rest is reported as unsent.
+	if (mode != UploadMode::Single) {
+		for (int attempt = 0; attempt < 5; attempt++) {
+			if (api.drain_batch())
+				break;
+		}
+	}
+
+	double total_s =
+		std::chrono::duration<double>(bench_clock::now() - start)
+			.count();
+
+	std::vector<double> blocked;
+	uint64_t rejected = 0;
+	for (const ProducerResult &r : results) {
+		blocked.insert(blocked.end(), r.blocked_ms.begin(),
+			       r.blocked_ms.end());
+		rejected += r.rejected;
+	}
+	double blocked_total = 0.0;
+	for (double ms : blocked)
+		blocked_total += ms;
+
+	server.stop();
+
+	UploadStats up = api.get_stats();
+	MockServerStats srv = server.stats();
+	std::vector<double> latency = api.take_latencies();
+
+	printf("offered:   %d events, %s, %d producer(s)\n", events,
+	       rate > 0.0 ? (std::to_string((int)rate) + "/s").c_str()
+			  : "unpaced",
+	       producers);
+	printf("achieved:  %.1f events/s (%.2f s producing, %.2f s total)\n",
+	       events / std::max(produce_s, 1e-9), produce_s, total_s);
+	printf("caller:    blocked p50 %.2f ms, p99 %.2f ms, max %.2f ms, "
+	       "%.1f%% of producer time; %llu calls reported failure\n",
+	       percentile(blocked, 0.50), percentile(blocked, 0.99),
+	       percentile(blocked, 1.0),
+	       100.0 * blocked_total / 1000.0 /
+		       std::max(produce_s * producers, 1e-9),
+	       (unsigned long long)rejected);
+	printf("requests:  latency p50 %.2f ms, p95 %.2f ms, p99 %.2f ms "
+	       "over %zu requests; %llu without a response\n",
+	       percentile(latency, 0.50), percentile(latency, 0.95),
+	       percentile(latency, 0.99), latency.size(),
+	       (unsigned long long)up.failed_requests);
+	printf("client:    %llu events sent in %llu requests, "
+	       "%llu payload bytes, %llu dropped, %zu unsent\n",
+	       (unsigned long long)up.events,
+	       (unsigned long long)up.requests,
+	       (unsigned long long)up.payload_bytes,
+	       (unsigned long long)up.dropped_events, api.pending_events());
+	printf("server:    %llu connections, %llu requests "
+	       "(%llu ok, %llu 503, %llu 415, %llu stalled), %llu bytes\n",
+	       (unsigned long long)srv.connections,
+	       (unsigned long long)srv.requests, (unsigned long long)srv.ok,
+	       (unsigned long long)srv.errors,
+	       (unsigned long long)srv.rejected,
+	       (unsigned long long)srv.stalls,
+	       (unsigned long long)srv.bytes_received);
+	return 0;
+}
@@ -0,0 +1,257 @@
+#include "mock-api-server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// How often blocked threads re-check for stop()
+#define POLL_SLICE_MS 50
+
+MockApiServer::MockApiServer()
+	: cfg(), listen_fd(-1), listen_port(0), running(false)
+{
+}
+
+MockApiServer::~MockApiServer()
+{
+	stop();
+}
+
+bool MockApiServer::start(const MockServerConfig &config)
+{
+	cfg = config;
+	rng.seed(config.seed);
+
+	listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (listen_fd < 0)
+		return false;
+
+	int one = 1;
+	setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+
+	socklen_t len = sizeof(addr);
+	if (bind(listen_fd, (sockaddr *)&addr, sizeof(addr)) != 0 ||
+	    listen(listen_fd, 128) != 0 ||
+	    getsockname(listen_fd, (sockaddr *)&addr, &len) != 0) {
+		close(listen_fd);
+		listen_fd = -1;
+		return false;
+	}
+
+	listen_port = ntohs(addr.sin_port);
+	running = true;
+	acceptor = std::thread(&MockApiServer::accept_loop, this);
+	return true;
+}
+
+void MockApiServer::stop()
+{
+	if (!running.exchange(false))
+		return;
+
+	if (acceptor.joinable())
+		acceptor.join();
+	close(listen_fd);
+	listen_fd = -1;
+
+	std::vector<Connection> threads;
+	{
+		std::lock_guard<std::mutex> lock(connections_mutex);
+		threads.swap(connections);
+	}
+	for (Connection &c : threads)
+		c.thread.join();
+}
+
+MockServerStats MockApiServer::stats() const
+{
+	MockServerStats s;
+	s.connections = n_connections;
+	s.requests = n_requests;
+	s.ok = n_ok;
+	s.errors = n_errors;
+	s.rejected = n_rejected;
+	s.stalls = n_stalls;
+	s.bytes_received = n_bytes;
+	return s;
+}
+
+bool MockApiServer::wait_readable(int fd)
+{
+	while (running) {
+		pollfd pfd = {fd, POLLIN, 0};
+		int n = poll(&pfd, 1, POLL_SLICE_MS);
+		if (n > 0)
+			return true;
+		if (n < 0)
+			return false;
+	}
+	return false;
+}
+
+void MockApiServer::sleep_ms(int ms)
+{
+	auto until = std::chrono::steady_clock::now() +
+		     std::chrono::milliseconds(ms);
+	while (running && std::chrono::steady_clock::now() < until)
+		std::this_thread::sleep_for(std::chrono::milliseconds(
+			std::min(ms, POLL_SLICE_MS)));
+}
+
+void MockApiServer::accept_loop()
+{
+	while (wait_readable(listen_fd)) {
+		int fd = accept(listen_fd, nullptr, nullptr);
+		if (fd < 0)
+			continue;
+
+		n_connections++;
+		std::lock_guard<std::mutex> lock(connections_mutex);
+
+		// A client opening a connection per request leaves many
+		// finished threads behind; reap them as we go
+		auto finished = [](Connection &c) {
+			if (!c.done->load())
+				return false;
+			c.thread.join();
+			return true;
+		};
+		connections.erase(std::remove_if(connections.begin(),
+						 connections.end(), finished),
+				  connections.end());
+
+		Connection c;
+		c.done = std::make_shared<std::atomic<bool>>(false);
+		c.thread = std::thread(&MockApiServer::serve, this, fd, c.done);
+		connections.push_back(std::move(c));
+	}
+}
+
+static size_t content_length(const std::string &headers)
+{
+	std::string lower(headers);
+	std::transform(lower.begin(), lower.end(), lower.begin(),
+		       [](unsigned char c) { return (char)std::tolower(c); });
+
+	size_t pos = lower.find("\r\ncontent-length:");
+	if (pos == std::string::npos)
+		return 0;
+	return (size_t)std::strtoul(lower.c_str() + pos + 17, nullptr, 10);
+}
+
+static bool send_all(int fd, const std::string &data)
+{
+	size_t sent = 0;
+	while (sent < data.size()) {
+		ssize_t n = send(fd, data.data() + sent, data.size() - sent,
+				 MSG_NOSIGNAL);
+		if (n <= 0)
+			return false;
+		sent += (size_t)n;
+	}
+	return true;
+}
+
+/* Append whatever arrives next; false once the client or server is gone */
+bool MockApiServer::recv_more(int fd, std::string &buf)
+{
+	if (!wait_readable(fd))
+		return false;
+
+	char chunk[4096];
+	ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+	if (n <= 0)
+		return false;
+	buf.append(chunk, (size_t)n);
+	return true;
+}
+
+/* Take one complete request off the front of buf, reading more as needed */
+bool MockApiServer::read_request(int fd, std::string &buf,
+				 std::string &headers)
+{
+	size_t header_end;
+	while ((header_end = buf.find("\r\n\r\n")) == std::string::npos) {
+		if (!recv_more(fd, buf))
+			return false;
+	}
+
+	headers = buf.substr(0, header_end);
+	size_t total = header_end + 4 + content_length(headers);
+	while (buf.size() < total) {
+		if (!recv_more(fd, buf))
+			return false;
+	}
+
+	n_requests++;
+	n_bytes += total;
+	buf.erase(0, total);
+	return true;
+}
+
+void MockApiServer::serve(int fd, std::shared_ptr<std::atomic<bool>> done)
+{
+	std::string buf;
+	std::string headers;
+
+	// Keep-alive: serve requests until the client closes
+	while (read_request(fd, buf, headers)) {
+		bool binary = headers.find("x-sr-batch") != std::string::npos;
+
+		double roll;
+		int delay;
+		{
+			std::lock_guard<std::mutex> lock(rng_mutex);
+			std::uniform_real_distribution<double> unit(0.0, 1.0);
+			roll = unit(rng);
+			delay = cfg.latency_ms;
+			if (cfg.jitter_ms > 0)
+				delay += (int)(rng() %
+					       (uint32_t)(cfg.jitter_ms + 1));
+		}
+
+		if (roll < cfg.stall_rate) {
+			// Hold the request without answering, then hang up
+			n_stalls++;
+			sleep_ms(cfg.stall_ms);
+			break;
+		}
+
+		sleep_ms(delay);
+
+		const char *status = "200 OK";
+		if (cfg.reject_binary && binary) {
+			status = "415 Unsupported Media Type";
+			n_rejected++;
+		} else if (roll < cfg.stall_rate + cfg.error_rate) {
+			status = "503 Service Unavailable";
+			n_errors++;
+		} else {
+			n_ok++;
+		}
+
+		std::string response = std::string("HTTP/1.1 ") + status +
+				       "\r\nContent-Length: 2\r\n"
+				       "Content-Type: application/json\r\n\r\n"
+				       "{}";
+		if (!send_all(fd, response))
+			break;
+	}
+
+	close(fd);
+	done->store(true);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Stand-in for the webapp's SR endpoint, for benchmarking ApiClient
+ * offline. Accepts any POST on 127.0.0.1, one thread per connection, and
+ * answers after a configurable delay with a configurable failure mix.
+ * POSIX sockets only.
+ */
+
+struct MockServerConfig {
+	int latency_ms;       // base delay before each response
+	int jitter_ms;        // plus uniform 0..jitter_ms
+	double error_rate;    // fraction answered with HTTP 503
+	double stall_rate;    // fraction held for stall_ms, then dropped
+	int stall_ms;         // should exceed the client timeout
+	bool reject_binary;   // answer binary batches with HTTP 415
+	uint32_t seed;
+};
+
+struct MockServerStats {
+	uint64_t connections;
+	uint64_t requests;
+	uint64_t ok;
+	uint64_t errors;
+	uint64_t rejected;
+	uint64_t stalls;
+	uint64_t bytes_received;
+};
+
+class MockApiServer {
+public:
+	MockApiServer();
+	~MockApiServer();
+
+	MockApiServer(const MockApiServer &) = delete;
+	MockApiServer &operator=(const MockApiServer &) = delete;
+
+	/** Listen on an ephemeral loopback port */
+	bool start(const MockServerConfig &config);
+	void stop();
+
+	uint16_t port() const { return listen_port; }
+	MockServerStats stats() const;
+
+private:
+	void accept_loop();
+	void serve(int fd, std::shared_ptr<std::atomic<bool>> done);
+	bool read_request(int fd, std::string &buf, std::string &headers);
+	bool recv_more(int fd, std::string &buf);
+	bool wait_readable(int fd);
+	void sleep_ms(int ms);
+
+	MockServerConfig cfg;
+	int listen_fd;
+	uint16_t listen_port;
+	std::atomic<bool> running;
+
+	struct Connection {
+		std::thread thread;
+		std::shared_ptr<std::atomic<bool>> done;
+	};
+
+	std::thread acceptor;
+	std::vector<Connection> connections;
+	std::mutex connections_mutex;
+
+	std::mt19937 rng;
+	std::mutex rng_mutex;
+
+	std::atomic<uint64_t> n_connections{0};
+	std::atomic<uint64_t> n_requests{0};
+	std::atomic<uint64_t> n_ok{0};
+	std::atomic<uint64_t> n_errors{0};
+	std::atomic<uint64_t> n_rejected{0};
+	std::atomic<uint64_t> n_stalls{0};
+	std::atomic<uint64_t> n_bytes{0};
+};
@@ -0,0 +1,492 @@
+/*
+ * sr-ocr-bench: runs OcrEngine::recognize over synthetic HUD frames and
+ * checks accuracy and p95 latency against a stored baseline.
+ *
+ *   sr-ocr-bench --tessdata <dir> [--samples N] [--seed S]
+ *                [--baseline <file>] [--write-baseline]
+ *                [--batch N] [--check-allocs]
+ *
+ * Exits non-zero if accuracy drops or p95 latency grows past the baseline's
+ * tolerances, so it can gate OCR changes without launching the game. p95 is
+ * compared in units of a fixed workload timed on the same machine, so the
+ * committed tools/ocr-baseline.txt, run by CTest, carries across machines.
+ * A baseline with no measured values yet exits with BENCH_SKIPPED. --batch
+ * also compares crops/s of OcrEngine::recognize_batch against one call per
+ * crop.
+ * --check-allocs (ENABLE_ALLOC_TRACKING builds) instead fails if the
+ * OCR engine or the screen gate allocates on frames that don't change the
+ * SR.
+ */
+
+#include "ocr-engine.h"
+#include "screen-gate.h"
+#include "synthetic-frames.h"
+#include "alloc-counter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Allowed regression before the bench fails, unless the baseline says
+#define ACCURACY_TOLERANCE 0.005
+#define P95_TOLERANCE 1.25
+// Renders timed to find this machine's latency unit
+#define CALIBRATION_RUNS 51
+// Exit status CTest reports as skipped rather than passed
+#define BENCH_SKIPPED 77
+
+// --check-allocs: distinct HUD frames and measured passes over them
+#define ALLOC_CHECK_FRAMES 32
+#define ALLOC_CHECK_ROUNDS 200
+
+struct BenchResult {
+	int samples;
+	uint32_t seed;
+	int correct;
+	double accuracy;
+	double p50_ms;
+	double p95_ms;
+	double unit_ms; // calibration workload on this machine
+	double p95_rel; // p95_ms / unit_ms
+	double accuracy_tolerance;
+	double p95_tolerance; // allowed growth factor of p95_rel
+};
+
+static double percentile(std::vector<double> v, double p)
+{
+	if (v.empty())
+		return 0.0;
+	std::sort(v.begin(), v.end());
+	size_t idx = (size_t)(p * (double)(v.size() - 1));
+	return v[idx];
+}
+
+/*
+ * Median time to render one fixed HUD frame. Tesseract and the renderer are
+ * both single-threaded CPU work, so their ratio moves far less between
+ * machines than either time in ms.
+ */
+static double calibration_unit_ms()
+{
+	SyntheticFrameGenerator gen(1);
+	SyntheticFrameParams params =
+		SyntheticFrameGenerator::default_params(2500);
+	SyntheticFrame frame;
+	std::vector<double> runs;
+	runs.reserve(CALIBRATION_RUNS);
+
+	for (int i = 0; i < CALIBRATION_RUNS; i++) {
+		auto start = std::chrono::steady_clock::now();
+		gen.render(params, frame);
+		runs.push_back(std::chrono::duration<double, std::milli>(
+				       std::chrono::steady_clock::now() - start)
+				       .count());
+	}
+	return std::max(percentile(runs, 0.50), 1e-6);
+}
+
+/*
+ * key=value lines, '#' comments. Values not measured yet read as -1, and
+ * tolerances not given fall back to the defaults above.
+ */
+static bool read_baseline(const std::string &path, BenchResult &out)
+{
+	std::ifstream in(path);
+	if (!in)
+		return false;
+
+	out = BenchResult();
+	out.seed = 1;
+	out.accuracy = -1.0;
+	out.p95_rel = -1.0;
+	out.accuracy_tolerance = ACCURACY_TOLERANCE;
+	out.p95_tolerance = P95_TOLERANCE;
+
+	std::string line;
+	while (std::getline(in, line)) {
+		size_t eq = line.find('=');
+		if (line.empty() || line[0] == '#' || eq == std::string::npos)
+			continue;
+		std::string key = line.substr(0, eq);
+		double val = std::atof(line.c_str() + eq + 1);
+		if (key == "accuracy")
+			out.accuracy = val;
+		else if (key == "accuracy_tolerance")
+			out.accuracy_tolerance = val;
+		else if (key == "p95_rel")
+			out.p95_rel = val;
+		else if (key == "p95_tolerance")
+			out.p95_tolerance = val;
+		else if (key == "samples")
+			out.samples = (int)val;
+		else if (key == "seed")
+			out.seed = (uint32_t)val;
+	}
+	return out.samples > 0;
+}
+
+static bool write_baseline(const std::string &path, const BenchResult &r)
+{
+	std::ofstream out(path);
+	if (!out)
+		return false;
+	out << "# sr-ocr-bench baseline, see README \"OCR Regression Bench\"\n";
+	out << "# recorded at p50 " << r.p50_ms << " ms, p95 " << r.p95_ms
+	    << " ms, latency unit " << r.unit_ms << " ms\n";
+	out << "samples=" << r.samples << "\n";
+	out << "seed=" << r.seed << "\n";
+	out << "accuracy=" << r.accuracy << "\n";
+	out << "accuracy_tolerance=" << r.accuracy_tolerance << "\n";
+	out << "p95_rel=" << r.p95_rel << "\n";
+	out << "p95_tolerance=" << r.p95_tolerance << "\n";
+	return true;
+}
+
+/*
+ * Render groups of `batch` frames and read each group twice from a cold
+ * cache: once crop by crop, once as a single stitched batch.
+ */
+static void run_batch_bench(OcrEngine &ocr, uint32_t seed, int samples,
+			    int batch)
+{
+	SyntheticFrameGenerator gen(seed);
+	std::vector<SyntheticFrame> frames((size_t)batch);
+	std::vector<int> expected((size_t)batch);
+	std::vector<OcrCrop> crops((size_t)batch);
+
+	double single_ms = 0.0, batch_ms = 0.0;
+	int single_correct = 0, batch_correct = 0;
+	int total = 0;
+
+	while (total < samples) {
+		int n = std::min(batch, samples - total);
+		crops.resize((size_t)n);
+		for (int i = 0; i < n; i++) {
+			SyntheticFrameParams params = gen.random_params();
+			gen.render(params, frames[i]);
+			expected[i] = params.sr;
+			crops[i] = {frames[i].bgra.data(), frames[i].linesize,
+				    frames[i].region};
+		}
+
+		ocr.cache().clear();
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < n; i++) {
+			int sr = ocr.recognize(crops[i].bgra_data,
+					       crops[i].linesize,
+					       crops[i].region);
+			single_correct += sr == expected[i];
+		}
+		single_ms += std::chrono::duration<double, std::milli>(
+				     std::chrono::steady_clock::now() - start)
+				     .count();
+
+		ocr.cache().clear();
+		start = std::chrono::steady_clock::now();
+		std::vector<OcrResult> results = ocr.recognize_batch(crops);
+		batch_ms += std::chrono::duration<double, std::milli>(
+				    std::chrono::steady_clock::now() - start)
+				    .count();
+
+		for (int i = 0; i < n; i++)
+			batch_correct += results[i].value == expected[i];
+		total += n;
+	}
+
+	printf("batch %d: single %.1f crops/s (accuracy %.4f), "
+	       "batched %.1f crops/s (accuracy %.4f)\n",
+	       batch, total * 1000.0 / std::max(single_ms, 1e-3),
+	       (double)single_correct / total,
+	       total * 1000.0 / std::max(batch_ms, 1e-3),
+	       (double)batch_correct / total);
+}
+
+/*
+ * The ScreenGate and OcrEngine calls the worker makes while the SR sits
+ * still: a gate check and a cache hit, a template match once the cache has
+ * been dropped, or a full Tesseract read of a crop the cache no longer
+ * holds. Warm up until every frame takes those paths, then count heap
+ * allocations over many more passes; there must be none outside Tesseract
+ * itself. The rest of the worker's frame (the frame copy, the overlay and
+ * push updates, history) needs a running OBS and is not covered.
+ */
+static int run_alloc_check(OcrEngine &ocr)
+{
+	if (!sr_alloc_tracking_enabled()) {
+		fprintf(stderr, "--check-allocs needs a build with "
+				"ENABLE_ALLOC_TRACKING=ON\n");
+		return 2;
+	}
+
+	SyntheticFrameGenerator gen(1);
+	std::vector<SyntheticFrame> frames;
+	frames.reserve(ALLOC_CHECK_FRAMES);
+	for (int i = 0; i < ALLOC_CHECK_FRAMES; i++) {
+		SyntheticFrameParams params =
+			SyntheticFrameGenerator::default_params(1000 + i * 97);
+		frames.emplace_back();
+		gen.render(params, frames.back());
+	}
+
+	// Warm-up: Tesseract reads each frame once, filling the cache and
+	// the digit templates. Keep the frames that now hit the cache.
+	ScreenGate gate;
+	std::vector<const SyntheticFrame *> steady;
+	steady.reserve(frames.size());
+	for (const SyntheticFrame &f : frames) {
+		int confidence = 0;
+		if (ocr.recognize(f.bgra.data(), f.linesize, f.region,
+				  &confidence) < 0)
+			continue;
+
+		uint64_t hits = ocr.cache().stats().hits;
+		ocr.recognize(f.bgra.data(), f.linesize, f.region);
+		if (ocr.cache().stats().hits == hits)
+			continue;
+
+		gate.check(f.bgra.data(), f.linesize, f.width, f.height,
+			   f.region);
+		gate.learn();
+		steady.push_back(&f);
+	}
+
+	if (steady.empty()) {
+		fprintf(stderr, "no frame reached a steady cache hit\n");
+		return 2;
+	}
+
+	// One unmeasured pass sizes the reusable buffers
+	uint64_t begin = 0;
+	uint64_t cache_allocs = 0, template_allocs = 0, tess_allocs = 0;
+	int template_hits = 0;
+	for (int round = 0; round <= ALLOC_CHECK_ROUNDS; round++) {
+		bool measured = round > 0;
+
+		begin = sr_alloc_count();
+		for (const SyntheticFrame *f : steady) {
+			bool provisional = false;
+			gate.check(f->bgra.data(), f->linesize, f->width,
+				   f->height, f->region);
+			ocr.recognize(f->bgra.data(), f->linesize, f->region);
+			ocr.recognize_fast(f->bgra.data(), f->linesize,
+					   f->region, provisional);
+		}
+		if (measured)
+			cache_allocs += sr_alloc_count() - begin;
+
+		// Templates answer while the cache is cold
+		ocr.cache().clear();
+		begin = sr_alloc_count();
+		for (const SyntheticFrame *f : steady) {
+			bool provisional = false;
+			int sr = ocr.recognize_fast(f->bgra.data(),
+						    f->linesize, f->region,
+						    provisional);
+			if (measured && sr >= 0 && provisional)
+				template_hits++;
+		}
+		if (measured)
+			template_allocs += sr_alloc_count() - begin;
+
+		// Cold cache again: the normal path reads with Tesseract and
+		// refills the cache for the next round
+		ocr.cache().clear();
+		begin = sr_alloc_count();
+		for (const SyntheticFrame *f : steady)
+			ocr.recognize(f->bgra.data(), f->linesize, f->region);
+		if (measured)
+			tess_allocs += sr_alloc_count() - begin;
+	}
+
+	int passes = ALLOC_CHECK_ROUNDS * (int)steady.size();
+	printf("alloc check: %d frames x %d rounds\n", (int)steady.size(),
+	       ALLOC_CHECK_ROUNDS);
+	printf("  gate + cache hit:  %llu allocations\n",
+	       (unsigned long long)cache_allocs);
+	printf("  template match:    %llu allocations (%d of %d matched)\n",
+	       (unsigned long long)template_allocs, template_hits, passes);
+	printf("  tesseract read:    %llu allocations\n",
+	       (unsigned long long)tess_allocs);
+
+	if (cache_allocs || template_allocs || tess_allocs) {
+		printf("FAIL: OCR engine allocated in steady state\n");
+		return 1;
+	}
+	printf("OK: no OCR engine allocations in steady state\n");
+	return 0;
+}
+
+static void usage()
+{
+	fprintf(stderr,
+		"usage: sr-ocr-bench --tessdata <dir> [--samples N] [--seed S]\n"
+		"                    [--baseline <file>] [--write-baseline]\n"
+		"                    [--batch N] [--check-allocs]\n");
+}
+
+int main(int argc, char **argv)
+{
+	std::string tessdata;
+	std::string baseline_path;
+	bool update_baseline = false;
+	int samples = 2000;
+	uint32_t seed = 1;
+	int batch = 0;
+	bool check_allocs = false;
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		bool has_value = i + 1 < argc;
+		if (!std::strcmp(arg, "--tessdata") && has_value)
+			tessdata = argv[++i];
+		else if (!std::strcmp(arg, "--samples") && has_value)
+			samples = std::atoi(argv[++i]);
+		else if (!std::strcmp(arg, "--seed") && has_value)
+			seed = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		else if (!std::strcmp(arg, "--baseline") && has_value)
+			baseline_path = argv[++i];
+		else if (!std::strcmp(arg, "--batch") && has_value)
+			batch = std::atoi(argv[++i]);
+		else if (!std::strcmp(arg, "--write-baseline"))
+			update_baseline = true;
+		else if (!std::strcmp(arg, "--check-allocs"))
+			check_allocs = true;
+		else {
+			usage();
+			return 2;
+		}
+	}
+
+	if (tessdata.empty() || samples <= 0) {
+		usage();
+		return 2;
+	}
+
+	OcrEngine ocr;
+	if (!ocr.init(tessdata)) {
+		fprintf(stderr, "OCR init failed (tessdata: %s)\n",
+			tessdata.c_str());
+		return 2;
+	}
+
+	if (check_allocs)
+		return run_alloc_check(ocr);
+
+	// Same seed, same frames: results are comparable across runs
+	SyntheticFrameGenerator gen(seed);
+	SyntheticFrame frame;
+	std::vector<double> latencies;
+	latencies.reserve((size_t)samples);
+
+	BenchResult result = {};
+	result.samples = samples;
+	result.seed = seed;
+	int misses = 0;
+
+	for (int i = 0; i < samples; i++) {
+		SyntheticFrameParams params = gen.random_params();
+		gen.render(params, frame);
+
+		// Measure Tesseract, not an earlier sample's cache entry
+		ocr.cache().clear();
+		auto start = std::chrono::steady_clock::now();
+		int sr = ocr.recognize(frame.bgra.data(), frame.linesize,
+				       frame.region);
+		auto end = std::chrono::steady_clock::now();
+
+		latencies.push_back(
+			std::chrono::duration<double, std::milli>(end - start)
+				.count());
+
+		if (sr == params.sr)
+			result.correct++;
+		else if (++misses <= 10)
+			printf("  miss: expected %d got %d (font %d, h %d, noise %d)\n",
+			       params.sr, sr, (int)params.font,
+			       params.digit_height, params.noise);
+	}
+
+	result.accuracy = (double)result.correct / (double)samples;
+	result.p50_ms = percentile(latencies, 0.50);
+	result.p95_ms = percentile(latencies, 0.95);
+	result.unit_ms = calibration_unit_ms();
+	result.p95_rel = result.p95_ms / result.unit_ms;
+
+	printf("samples:  %d\n", samples);
+	printf("accuracy: %.4f (%d correct)\n", result.accuracy,
+	       result.correct);
+	printf("latency:  p50 %.2f ms, p95 %.2f ms (%.2f units of %.3f ms)\n",
+	       result.p50_ms, result.p95_ms, result.p95_rel, result.unit_ms);
+
+	if (batch > 1)
+		run_batch_bench(ocr, seed, samples, batch);
+
+	// Without a baseline this is a report, not a check
+	if (baseline_path.empty())
+		return 0;
+
+	// Rewriting a baseline keeps its tolerances
+	BenchResult base;
+	bool have_base = read_baseline(baseline_path, base);
+	if (update_baseline) {
+		result.accuracy_tolerance = ACCURACY_TOLERANCE;
+		result.p95_tolerance = P95_TOLERANCE;
+		if (have_base) {
+			result.accuracy_tolerance = base.accuracy_tolerance;
+			result.p95_tolerance = base.p95_tolerance;
+		}
+		if (!write_baseline(baseline_path, result)) {
+			fprintf(stderr, "could not write %s\n",
+				baseline_path.c_str());
+			return 2;
+		}
+		printf("baseline written to %s\n", baseline_path.c_str());
+		return 0;
+	}
+
+	// A check must have something to check against
+	if (!have_base) {
+		printf("FAIL: no baseline at %s (use --write-baseline)\n",
+		       baseline_path.c_str());
+		return 1;
+	}
+	if (base.samples != samples || base.seed != seed) {
+		printf("FAIL: baseline was recorded with --samples %d "
+		       "--seed %u\n",
+		       base.samples, base.seed);
+		return 1;
+	}
+
+	// Passing against numbers nobody measured would prove nothing
+	if (base.accuracy < 0.0 || base.p95_rel < 0.0) {
+		printf("SKIP: %s has no measured accuracy and p95 yet "
+		       "(record them with --write-baseline)\n",
+		       baseline_path.c_str());
+		return BENCH_SKIPPED;
+	}
+
+	bool ok = true;
+	if (result.accuracy < base.accuracy - base.accuracy_tolerance) {
+		printf("FAIL: accuracy %.4f below baseline %.4f - %.4f\n",
+		       result.accuracy, base.accuracy,
+		       base.accuracy_tolerance);
+		ok = false;
+	}
+	if (result.p95_rel > base.p95_rel * base.p95_tolerance) {
+		printf("FAIL: p95 %.2f units above baseline %.2f x %.2f\n",
+		       result.p95_rel, base.p95_rel, base.p95_tolerance);
+		ok = false;
+	}
+
+	if (!ok)
+		return 1;
+
+	printf("OK: within baseline (accuracy %.4f, p95 %.2f units)\n",
+	       base.accuracy, base.p95_rel);
+	return 0;
+}
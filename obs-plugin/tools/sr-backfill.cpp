@@ -0,0 +1,478 @@
+/*
+ * sr-backfill: rebuilds SR history from recorded videos.
+ *
+ *   sr-backfill --tessdata <dir> --region x,y,w,h [--interval S]
+ *               [--jobs N] [--chunk-seconds S] [--screen-gate]
+ *               [--start UNIX] [--output <csv>] [--api-url URL
+ *               --api-key KEY [--upload-mode gzip|binary]
+ *               [--batch-size N]] video...
+ *
+ * Each video is cut into time chunks that worker threads read in parallel,
+ * one OcrEngine per thread. A sample seeks to the nearest keyframe and
+ * decodes only that frame. The per-chunk reads are merged back into one
+ * timeline, reduced to SR changes with the same rule as the source's
+ * worker, and optionally uploaded as timestamped batches. Exits non-zero
+ * if any change fails to upload.
+ */
+
+#include "ocr-engine.h"
+#include "screen-gate.h"
+#include "api-client.h"
+#include "vod-reader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+using bench_clock = std::chrono::steady_clock;
+
+// Failed flushes in a row before the upload gives up
+#define UPLOAD_ATTEMPTS 5
+
+struct VodFile {
+	std::string path;
+	double duration;
+	int64_t start; // unix time of the first frame
+};
+
+struct Chunk {
+	size_t file;
+	double begin;
+	double end;
+};
+
+struct Sample {
+	double time; // seconds into the file
+	int sr;
+	int confidence;
+};
+
+struct WorkerStats {
+	uint64_t reads;      // keyframe seeks
+	uint64_t duplicates; // seeks that landed on an already read keyframe
+	uint64_t gated;
+	uint64_t failures;
+	double decode_ms;
+	double ocr_ms;
+};
+
+struct TimelineEvent {
+	int64_t timestamp;
+	int sr;
+	int confidence;
+	size_t file;
+	double time;
+};
+
+/*
+ * OBS names recordings "%CCYY-%MM-%DD %hh-%mm-%ss" by default, in local
+ * time. Used when the container carries no creation time.
+ */
+static int64_t start_from_filename(const std::string &path)
+{
+	size_t slash = path.find_last_of("/\\");
+	std::string name =
+		slash == std::string::npos ? path : path.substr(slash + 1);
+
+	std::tm tm = {};
+	if (sscanf(name.c_str(), "%d-%d-%d %d-%d-%d", &tm.tm_year, &tm.tm_mon,
+		   &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6)
+		return -1;
+
+	tm.tm_year -= 1900;
+	tm.tm_mon -= 1;
+	tm.tm_isdst = -1;
+	std::time_t t = std::mktime(&tm);
+	return t == (std::time_t)-1 ? -1 : (int64_t)t;
+}
+
+/* Quoted CSV field; a quote inside it is written twice */
+static void write_csv_field(FILE *out, const std::string &text)
+{
+	fputc('"', out);
+	for (char c : text) {
+		if (c == '"')
+			fputc('"', out);
+		fputc(c, out);
+	}
+	fputc('"', out);
+}
+
+static bool parse_region(const char *arg, OcrRegion &region)
+{
+	return sscanf(arg, "%d,%d,%d,%d", &region.x, &region.y, &region.width,
+		      &region.height) == 4 &&
+	       region.x >= 0 && region.y >= 0 && region.width > 0 &&
+	       region.height > 0;
+}
+
+static void read_chunk(OcrEngine &ocr, VodReader &reader, ScreenGate *gate,
+		       const VodFile &file, const Chunk &chunk,
+		       const OcrRegion &region, double interval,
+		       VodFrame &frame, std::vector<Sample> &out,
+		       WorkerStats &stats)
+{
+	if (reader.path() != file.path && !reader.open(file.path))
+		return;
+
+	double last_time = -1.0;
+	for (double t = chunk.begin; t < chunk.end; t += interval) {
+		auto decode_begin = bench_clock::now();
+		bool got = reader.read_keyframe(t, frame);
+		stats.decode_ms += std::chrono::duration<double, std::milli>(
+					   bench_clock::now() - decode_begin)
+					   .count();
+		stats.reads++;
+		if (!got)
+			break;
+
+		// Keyframes further apart than the interval come back again
+		if (frame.time == last_time) {
+			stats.duplicates++;
+			continue;
+		}
+		last_time = frame.time;
+
+		if (region.x + region.width > frame.width ||
+		    region.y + region.height > frame.height) {
+			fprintf(stderr,
+				"%s: region is outside the %dx%d frame\n",
+				file.path.c_str(), frame.width, frame.height);
+			return;
+		}
+
+		if (gate && !gate->check(frame.bgra.data(), frame.linesize,
+					 frame.width, frame.height, region)) {
+			stats.gated++;
+			continue;
+		}
+
+		auto ocr_begin = bench_clock::now();
+		int confidence = 0;
+		int sr = ocr.recognize(frame.bgra.data(), frame.linesize,
+				       region, &confidence);
+		stats.ocr_ms += std::chrono::duration<double, std::milli>(
+					bench_clock::now() - ocr_begin)
+					.count();
+
+		if (sr < 0) {
+			stats.failures++;
+			continue;
+		}
+		if (gate && confidence >= OCR_CACHE_MIN_CONFIDENCE)
+			gate->learn();
+
+		out.push_back({frame.time, sr, confidence});
+	}
+}
+
+static void usage()
+{
+	fprintf(stderr,
+		"usage: sr-backfill --tessdata <dir> --region x,y,w,h\n"
+		"         [--interval S] [--jobs N] [--chunk-seconds S]\n"
+		"         [--screen-gate] [--start UNIX] [--output <csv>]\n"
+		"         [--api-url URL --api-key KEY]\n"
+		"         [--upload-mode gzip|binary] [--batch-size N]\n"
+		"         video...\n");
+}
+
+int main(int argc, char **argv)
+{
+	std::string tessdata;
+	std::string output_path;
+	std::string api_url;
+	std::string api_key;
+	OcrRegion region = {0, 0, 0, 0};
+	bool have_region = false;
+	double interval = 3.0;
+	double chunk_seconds = 300.0;
+	int jobs = (int)std::thread::hardware_concurrency();
+	bool use_gate = false;
+	int64_t start_override = -1;
+	UploadMode upload_mode = UploadMode::BinaryBatch;
+	int batch_size = 100;
+	std::vector<std::string> paths;
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		bool has_value = i + 1 < argc;
+		if (!std::strcmp(arg, "--tessdata") && has_value)
+			tessdata = argv[++i];
+		else if (!std::strcmp(arg, "--region") && has_value)
+			have_region = parse_region(argv[++i], region);
+		else if (!std::strcmp(arg, "--interval") && has_value)
+			interval = std::atof(argv[++i]);
+		else if (!std::strcmp(arg, "--jobs") && has_value)
+			jobs = std::atoi(argv[++i]);
+		else if (!std::strcmp(arg, "--chunk-seconds") && has_value)
+			chunk_seconds = std::atof(argv[++i]);
+		else if (!std::strcmp(arg, "--screen-gate"))
+			use_gate = true;
+		else if (!std::strcmp(arg, "--start") && has_value)
+			start_override = std::atoll(argv[++i]);
+		else if (!std::strcmp(arg, "--output") && has_value)
+			output_path = argv[++i];
+		else if (!std::strcmp(arg, "--api-url") && has_value)
+			api_url = argv[++i];
+		else if (!std::strcmp(arg, "--api-key") && has_value)
+			api_key = argv[++i];
+		else if (!std::strcmp(arg, "--upload-mode") && has_value) {
+			const char *m = argv[++i];
+			if (!std::strcmp(m, "gzip"))
+				upload_mode = UploadMode::GzipJson;
+			else if (!std::strcmp(m, "binary"))
+				upload_mode = UploadMode::BinaryBatch;
+			else {
+				// Single posts are stamped with the send time
+				usage();
+				return 2;
+			}
+		} else if (!std::strcmp(arg, "--batch-size") && has_value)
+			batch_size = std::atoi(argv[++i]);
+		else if (arg[0] == '-') {
+			usage();
+			return 2;
+		} else
+			paths.push_back(arg);
+	}
+
+	if (tessdata.empty() || !have_region || paths.empty() ||
+	    interval <= 0.0 || chunk_seconds <= 0.0 || batch_size <= 0 ||
+	    api_url.empty() != api_key.empty()) {
+		usage();
+		return 2;
+	}
+	if (start_override >= 0 && paths.size() > 1) {
+		fprintf(stderr, "--start needs exactly one video\n");
+		return 2;
+	}
+	jobs = std::max(jobs, 1);
+
+	// Probe every file for its length and wall-clock start
+	std::vector<VodFile> files;
+	double total_duration = 0.0;
+	{
+		VodReader probe;
+		for (const std::string &path : paths) {
+			if (!probe.open(path))
+				continue;
+
+			VodFile f = {path, probe.duration(), start_override};
+			if (f.start < 0)
+				f.start = probe.creation_time();
+			if (f.start < 0)
+				f.start = start_from_filename(path);
+			if (f.start < 0) {
+				fprintf(stderr,
+					"%s: no start time in the metadata or "
+					"file name, skipped (see --start)\n",
+					path.c_str());
+				continue;
+			}
+			if (f.duration <= 0.0) {
+				fprintf(stderr,
+					"%s: unknown duration, skipped\n",
+					path.c_str());
+				continue;
+			}
+
+			total_duration += f.duration;
+			files.push_back(f);
+		}
+	}
+	if (files.empty())
+		return 1;
+
+	std::sort(files.begin(), files.end(),
+		  [](const VodFile &a, const VodFile &b) {
+			  return a.start < b.start;
+		  });
+
+	// Enough chunks to keep every worker busy, each a whole number of
+	// sampling intervals so samples stay evenly spaced across chunks
+	double chunk_len = std::min(chunk_seconds, total_duration / jobs);
+	chunk_len = std::max(1.0, std::ceil(chunk_len / interval)) * interval;
+
+	std::vector<Chunk> chunks;
+	for (size_t f = 0; f < files.size(); f++) {
+		for (double t = 0.0; t < files[f].duration; t += chunk_len)
+			chunks.push_back({f, t,
+					  std::min(t + chunk_len,
+						   files[f].duration)});
+	}
+
+	std::vector<std::vector<Sample>> results(chunks.size());
+	std::vector<WorkerStats> stats((size_t)jobs, WorkerStats{});
+	std::atomic<size_t> next_chunk{0};
+	std::atomic<bool> init_failed{false};
+
+	auto start = bench_clock::now();
+	std::vector<std::thread> workers;
+	for (int w = 0; w < jobs; w++) {
+		workers.emplace_back([&, w] {
+			OcrEngine ocr;
+			if (!ocr.init(tessdata)) {
+				init_failed = true;
+				return;
+			}
+			VodReader reader;
+			VodFrame frame;
+			ScreenGate gate;
+
+			size_t c;
+			while ((c = next_chunk++) < chunks.size()) {
+				const Chunk &chunk = chunks[c];
+				read_chunk(ocr, reader,
+					   use_gate ? &gate : nullptr,
+					   files[chunk.file], chunk, region,
+					   interval, frame, results[c],
+					   stats[(size_t)w]);
+			}
+		});
+	}
+	for (std::thread &t : workers)
+		t.join();
+
+	double wall_s =
+		std::chrono::duration<double>(bench_clock::now() - start)
+			.count();
+
+	if (init_failed) {
+		fprintf(stderr, "OCR init failed (tessdata: %s)\n",
+			tessdata.c_str());
+		return 2;
+	}
+
+	// Merge: chunks are in file order, then time order. A keyframe
+	// before a chunk boundary can be read by both chunks; keep one.
+	std::vector<TimelineEvent> timeline;
+	int prev = -1;
+	for (size_t f = 0; f < files.size(); f++) {
+		std::vector<Sample> samples;
+		for (size_t c = 0; c < chunks.size(); c++) {
+			if (chunks[c].file == f)
+				samples.insert(samples.end(),
+					       results[c].begin(),
+					       results[c].end());
+		}
+		std::stable_sort(samples.begin(), samples.end(),
+				 [](const Sample &a, const Sample &b) {
+					 return a.time < b.time;
+				 });
+		samples.erase(std::unique(samples.begin(), samples.end(),
+					  [](const Sample &a, const Sample &b) {
+						  return a.time == b.time;
+					  }),
+			      samples.end());
+
+		// Same rule as the source's worker: a confident read that
+		// differs from the last SR is a change. prev carries across
+		// files, so a session resuming at the same SR adds nothing.
+		for (const Sample &s : samples) {
+			if (s.sr == prev)
+				continue;
+			timeline.push_back(
+				{files[f].start + (int64_t)s.time, s.sr,
+				 s.confidence, f, s.time});
+			prev = s.sr;
+		}
+	}
+
+	FILE *out = stdout;
+	if (!output_path.empty() &&
+	    !(out = fopen(output_path.c_str(), "w"))) {
+		fprintf(stderr, "cannot write %s\n", output_path.c_str());
+		return 2;
+	}
+	fprintf(out, "timestamp,sr,confidence,file,video_time\n");
+	for (const TimelineEvent &e : timeline) {
+		fprintf(out, "%lld,%d,%d,", (long long)e.timestamp, e.sr,
+			e.confidence);
+		write_csv_field(out, files[e.file].path);
+		fprintf(out, ",%.2f\n", e.time);
+	}
+	if (out != stdout)
+		fclose(out);
+
+	WorkerStats total = {};
+	for (const WorkerStats &s : stats) {
+		total.reads += s.reads;
+		total.duplicates += s.duplicates;
+		total.gated += s.gated;
+		total.failures += s.failures;
+		total.decode_ms += s.decode_ms;
+		total.ocr_ms += s.ocr_ms;
+	}
+	uint64_t decoded = total.reads - total.duplicates;
+
+	fprintf(stderr,
+		"videos:    %zu, %.1f h in %zu chunks of %.0f s, %d jobs\n",
+		files.size(), total_duration / 3600.0, chunks.size(),
+		chunk_len, jobs);
+	fprintf(stderr,
+		"samples:   %llu keyframes (%llu repeats skipped), %llu gated, "
+		"%llu unreadable\n",
+		(unsigned long long)decoded,
+		(unsigned long long)total.duplicates,
+		(unsigned long long)total.gated,
+		(unsigned long long)total.failures);
+	fprintf(stderr,
+		"time:      %.1f s wall, %.0fx real time; per sample %.2f ms "
+		"decode, %.2f ms OCR\n",
+		wall_s, total_duration / std::max(wall_s, 1e-9),
+		total.decode_ms / std::max<uint64_t>(total.reads, 1),
+		total.ocr_ms /
+			std::max<uint64_t>(decoded - total.gated, 1));
+	fprintf(stderr, "timeline:  %zu SR changes\n", timeline.size());
+
+	if (api_url.empty())
+		return 0;
+
+	// Batches carry each event's own timestamp, so history lands where
+	// it happened
+	ApiClient api;
+	api.configure(api_url, api_key);
+	api.configure_batching(upload_mode, (size_t)batch_size, 3600);
+
+	// Queue one batch only once the last has gone out, so an outage
+	// can't grow the backlog past its cap. A failed batch stays queued
+	// and is retried; five failures in a row give up.
+	size_t next = 0;
+	int failures = 0;
+	while (failures < UPLOAD_ATTEMPTS) {
+		if (api.pending_events() == 0) {
+			if (next == timeline.size())
+				break;
+			size_t end = std::min(next + (size_t)batch_size,
+					      timeline.size());
+			for (; next < end; next++)
+				api.queue_sr(timeline[next].sr,
+					     timeline[next].timestamp);
+		}
+
+		if (api.flush_batch())
+			failures = 0;
+		else
+			failures++;
+	}
+
+	UploadStats up = api.get_stats();
+	size_t unsent = timeline.size() - next + api.pending_events();
+	fprintf(stderr,
+		"upload:    %llu of %zu events in %llu requests, "
+		"%llu bytes, %llu dropped, %zu unsent\n",
+		(unsigned long long)up.events, timeline.size(),
+		(unsigned long long)up.requests,
+		(unsigned long long)up.payload_bytes,
+		(unsigned long long)up.dropped_events, unsent);
+	return up.dropped_events || unsent ? 1 : 0;
+}
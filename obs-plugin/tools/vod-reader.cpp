@@ -0,0 +1,201 @@
+#include "vod-reader.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/dict.h>
+#include <libswscale/swscale.h>
+}
+
+#include <cstdio>
+#include <cstring>
+
+VodReader::VodReader()
+	: fmt(nullptr),
+	  codec(nullptr),
+	  frame(nullptr),
+	  packet(nullptr),
+	  sws(nullptr),
+	  stream_index(-1),
+	  time_base(0.0),
+	  start_pts(0)
+{
+}
+
+VodReader::~VodReader()
+{
+	close();
+}
+
+bool VodReader::open(const std::string &path)
+{
+	close();
+
+	if (avformat_open_input(&fmt, path.c_str(), nullptr, nullptr) < 0) {
+		fprintf(stderr, "%s: cannot open\n", path.c_str());
+		return false;
+	}
+	if (avformat_find_stream_info(fmt, nullptr) < 0) {
+		fprintf(stderr, "%s: no stream info\n", path.c_str());
+		close();
+		return false;
+	}
+
+	const AVCodec *decoder = nullptr;
+	stream_index = av_find_best_stream(fmt, AVMEDIA_TYPE_VIDEO, -1, -1,
+					   &decoder, 0);
+	if (stream_index < 0 || !decoder) {
+		fprintf(stderr, "%s: no decodable video stream\n",
+			path.c_str());
+		close();
+		return false;
+	}
+
+	AVStream *stream = fmt->streams[stream_index];
+	codec = avcodec_alloc_context3(decoder);
+	if (!codec ||
+	    avcodec_parameters_to_context(codec, stream->codecpar) < 0) {
+		close();
+		return false;
+	}
+
+	// Parallelism comes from decoding several chunks at once; frame
+	// threads would only add latency to each single-frame decode
+	codec->thread_count = 1;
+	if (avcodec_open2(codec, decoder, nullptr) < 0) {
+		fprintf(stderr, "%s: cannot open decoder %s\n", path.c_str(),
+			decoder->name);
+		close();
+		return false;
+	}
+
+	frame = av_frame_alloc();
+	packet = av_packet_alloc();
+	time_base = av_q2d(stream->time_base);
+	start_pts = stream->start_time != AV_NOPTS_VALUE ? stream->start_time
+							 : 0;
+	file_path = path;
+	return true;
+}
+
+void VodReader::close()
+{
+	sws_freeContext(sws);
+	sws = nullptr;
+	av_packet_free(&packet);
+	av_frame_free(&frame);
+	avcodec_free_context(&codec);
+	avformat_close_input(&fmt);
+	stream_index = -1;
+	file_path.clear();
+}
+
+double VodReader::duration() const
+{
+	if (!fmt)
+		return 0.0;
+
+	AVStream *stream = fmt->streams[stream_index];
+	if (stream->duration != AV_NOPTS_VALUE)
+		return (double)stream->duration * time_base;
+	if (fmt->duration != AV_NOPTS_VALUE)
+		return (double)fmt->duration / AV_TIME_BASE;
+	return 0.0;
+}
+
+/* Days since 1970-01-01 for a proleptic Gregorian date */
+static int64_t days_from_civil(int64_t y, int m, int d)
+{
+	y -= m <= 2;
+	int64_t era = (y >= 0 ? y : y - 399) / 400;
+	int64_t yoe = y - era * 400;
+	int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+	int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + doe - 719468;
+}
+
+int64_t VodReader::creation_time() const
+{
+	if (!fmt)
+		return -1;
+
+	// ISO 8601 in UTC, e.g. 2024-01-15T20:31:07.000000Z
+	AVDictionaryEntry *tag =
+		av_dict_get(fmt->metadata, "creation_time", nullptr, 0);
+	int y, mo, d, h, mi, s;
+	if (!tag || sscanf(tag->value, "%d-%d-%dT%d:%d:%d", &y, &mo, &d, &h,
+			   &mi, &s) != 6)
+		return -1;
+
+	return days_from_civil(y, mo, d) * 86400 + h * 3600 + mi * 60 + s;
+}
+
+bool VodReader::read_keyframe(double time, VodFrame &out)
+{
+	if (!fmt)
+		return false;
+
+	int64_t target = start_pts + (int64_t)(time / time_base);
+	if (av_seek_frame(fmt, stream_index, target, AVSEEK_FLAG_BACKWARD) <
+	    0)
+		return false;
+	avcodec_flush_buffers(codec);
+
+	return decode_one(out);
+}
+
+/* Feed packets from the current position until one frame comes out */
+bool VodReader::decode_one(VodFrame &out)
+{
+	bool draining = false;
+
+	for (;;) {
+		int res = avcodec_receive_frame(codec, frame);
+		if (res == 0) {
+			bool converted = convert(frame, out);
+			av_frame_unref(frame);
+			return converted;
+		}
+		if (res != AVERROR(EAGAIN) || draining)
+			return false;
+
+		res = av_read_frame(fmt, packet);
+		if (res < 0) {
+			// End of file: flush what the decoder still holds
+			avcodec_send_packet(codec, nullptr);
+			draining = true;
+			continue;
+		}
+
+		if (packet->stream_index == stream_index)
+			avcodec_send_packet(codec, packet);
+		av_packet_unref(packet);
+	}
+}
+
+bool VodReader::convert(const AVFrame *src, VodFrame &out)
+{
+	sws = sws_getCachedContext(sws, src->width, src->height,
+				   (AVPixelFormat)src->format, src->width,
+				   src->height, AV_PIX_FMT_BGRA, SWS_POINT,
+				   nullptr, nullptr, nullptr);
+	if (!sws)
+		return false;
+
+	out.width = src->width;
+	out.height = src->height;
+	out.linesize = src->width * 4;
+	out.bgra.resize((size_t)out.linesize * out.height);
+
+	uint8_t *dst[4] = {out.bgra.data(), nullptr, nullptr, nullptr};
+	int dst_linesize[4] = {out.linesize, 0, 0, 0};
+	sws_scale(sws, src->data, src->linesize, 0, src->height, dst,
+		  dst_linesize);
+
+	int64_t pts = src->best_effort_timestamp != AV_NOPTS_VALUE
+			      ? src->best_effort_timestamp
+			      : src->pts;
+	out.time = pts != AV_NOPTS_VALUE ? (double)(pts - start_pts) * time_base
+					 : 0.0;
+	return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+struct SwsContext;
+
+struct VodFrame {
+	std::vector<uint8_t> bgra;
+	int width;
+	int height;
+	int linesize;
+	double time; // seconds from the start of the video
+};
+
+/**
+ * Reads sample frames out of a recorded video with FFmpeg. Each read seeks
+ * to the keyframe at or before the requested time and decodes only that
+ * frame, so the cost follows the sampling rate rather than the frame rate.
+ * One reader per thread.
+ */
+class VodReader {
+public:
+	VodReader();
+	~VodReader();
+
+	VodReader(const VodReader &) = delete;
+	VodReader &operator=(const VodReader &) = delete;
+
+	bool open(const std::string &path);
+	void close();
+	bool is_open() const { return fmt != nullptr; }
+	const std::string &path() const { return file_path; }
+
+	/** Length in seconds, or 0 if the container doesn't say */
+	double duration() const;
+
+	/** Unix time the recording started, from container metadata, or -1 */
+	int64_t creation_time() const;
+
+	/**
+	 * Decode the keyframe at or before time (seconds). Long GOPs make
+	 * neighbouring calls land on the same keyframe; out.time tells which
+	 * one was decoded.
+	 */
+	bool read_keyframe(double time, VodFrame &out);
+
+private:
+	bool decode_one(VodFrame &out);
+	bool convert(const AVFrame *frame, VodFrame &out);
+
+	std::string file_path;
+	AVFormatContext *fmt;
+	AVCodecContext *codec;
+	AVFrame *frame;
+	AVPacket *packet;
+	SwsContext *sws;
+	int stream_index;
+	double time_base;
+	int64_t start_pts;
+};